@@ -0,0 +1,225 @@
+#include "ARCFile.h"
+
+#include <fstream>
+#include <cstring>
+#include <limits>
+#include <cstdio>
+
+#include "EntryCodec.h"
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+constexpr char ARCMagic[4] = { 'A', 'R', 'C', '\0' };
+constexpr size_t ARCHeaderSize{ 8 };
+constexpr size_t ARCEntryNameSize{ 64 };
+constexpr size_t ARCEntrySize{ ARCEntryNameSize + sizeof(uint32_t) * 4 };
+constexpr uint32_t ARCDecompressedSizeMask{ 0x1FFFFFFF };
+constexpr uint64_t ARCDataAlignment{ 0x8000 }; // data of the game's own archives starts at 32KB
+
+template<typename T>
+void WriteLE(char* data, T value)
+{
+	std::memcpy(data, &value, sizeof(T));
+}
+
+template<typename T>
+T ReadLE(const char* data)
+{
+	T value{};
+	std::memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+std::string powe::ARCEntry::GetKey() const
+{
+	char typeHex[9]{};
+	std::snprintf(typeHex, sizeof(typeHex), "%08X", typeHash);
+	return name + "." + typeHex;
+}
+
+bool powe::ARCEntry::IsCompressed(const std::vector<char>& rawData) const
+{
+	if (compressedSize != decompressedSize)
+		return true;
+
+	// zlib header: deflate method with a valid check value
+	if (rawData.size() < 2)
+		return false;
+
+	const uint8_t cmf{ uint8_t(rawData[0]) };
+	const uint8_t flg{ uint8_t(rawData[1]) };
+	return (cmf & 0x0F) == 8 && (cmf * 256 + flg) % 31 == 0;
+}
+
+std::optional<powe::ARCFile> powe::ARCFile::Open(const fs::path& arcPath)
+{
+	std::ifstream fileStream(arcPath, std::ios::binary);
+	if (!fileStream.is_open())
+	{
+		Logger::Error("Failed to open file: ", arcPath);
+		return std::nullopt;
+	}
+
+	char header[ARCHeaderSize]{};
+	if (!fileStream.read(header, ARCHeaderSize) || std::memcmp(header, ARCMagic, sizeof(ARCMagic)) != 0)
+	{
+		Logger::Error("Not an ARC file: ", arcPath);
+		return std::nullopt;
+	}
+
+	ARCFile arcFile{};
+	arcFile.m_Path = arcPath;
+	arcFile.m_Version = ReadLE<uint16_t>(header + 4);
+
+	if (arcFile.m_Version != SupportedVersion)
+	{
+		Logger::Error("Unsupported ARC version ", arcFile.m_Version, ": ", arcPath);
+		return std::nullopt;
+	}
+
+	const uint16_t entryCount{ ReadLE<uint16_t>(header + 6) };
+
+	// read the whole TOC in one go, it's only 80 bytes per entry
+	std::vector<char> toc(entryCount * ARCEntrySize);
+	if (!fileStream.read(toc.data(), std::streamsize(toc.size())))
+	{
+		Logger::Error("Truncated ARC TOC: ", arcPath);
+		return std::nullopt;
+	}
+
+	arcFile.m_Entries.reserve(entryCount);
+
+	for (size_t i = 0; i < entryCount; i++)
+	{
+		const char* entryData{ toc.data() + i * ARCEntrySize };
+
+		ARCEntry entry{};
+		entry.name.assign(entryData, strnlen(entryData, ARCEntryNameSize));
+
+		const char* fields{ entryData + ARCEntryNameSize };
+		entry.typeHash = ReadLE<uint32_t>(fields);
+		entry.compressedSize = ReadLE<uint32_t>(fields + 4);
+
+		const uint32_t sizeAndFlags{ ReadLE<uint32_t>(fields + 8) };
+		entry.decompressedSize = sizeAndFlags & ARCDecompressedSizeMask;
+		entry.flags = sizeAndFlags & ~ARCDecompressedSizeMask;
+
+		entry.offset = ReadLE<uint32_t>(fields + 12);
+
+		arcFile.m_Entries.emplace_back(std::move(entry));
+	}
+
+	arcFile.m_Stream = std::move(fileStream);
+
+	return arcFile;
+}
+
+std::vector<char> powe::ARCFile::ReadRawEntry(const ARCEntry& entry) const
+{
+	std::vector<char> data(entry.compressedSize);
+
+	m_Stream.clear();
+	if (!m_Stream.seekg(entry.offset) || !m_Stream.read(data.data(), std::streamsize(data.size())))
+	{
+		Logger::Error("Failed to read ", entry.name, " from ", m_Path);
+		return {};
+	}
+
+	return data;
+}
+
+bool powe::ARCFile::ReadEntry(const ARCEntry& entry, const EntryCodec& codec, std::vector<char>& outData) const
+{
+	return DecodeEntry(entry, ReadRawEntry(entry), codec, outData);
+}
+
+bool powe::ARCFile::DecodeEntry(const ARCEntry& entry, std::vector<char> rawData, const EntryCodec& codec, std::vector<char>& outData) const
+{
+	if (rawData.size() != entry.compressedSize)
+		return false;
+
+	if (entry.IsCompressed(rawData) && codec.Decompress(rawData.data(), rawData.size(), entry.decompressedSize, outData))
+		return true;
+
+	// a stored entry that only looked like zlib is still fine
+	if (entry.compressedSize == entry.decompressedSize)
+	{
+		outData = std::move(rawData);
+		return true;
+	}
+
+	Logger::Error("Failed to decompress ", entry.name, " from ", m_Path);
+	return false;
+}
+
+powe::ARCWriter::ARCWriter(const fs::path& arcPath, uint16_t entryCount)
+	: m_Stream(arcPath, std::ios::binary | std::ios::trunc)
+	, m_EntryCount(entryCount)
+	, m_Offset(ARCHeaderSize + entryCount * ARCEntrySize)
+{
+	m_Entries.reserve(entryCount);
+	m_Offset = (m_Offset + ARCDataAlignment - 1) / ARCDataAlignment * ARCDataAlignment;
+
+	// leave room for the header and TOC, Close comes back to fill them in
+	const std::vector<char> padding(m_Offset);
+	m_Stream.write(padding.data(), std::streamsize(padding.size()));
+}
+
+bool powe::ARCWriter::WriteEntry(const ARCEntry& entry, const char* data, size_t size)
+{
+	if (m_Entries.size() >= m_EntryCount || entry.name.size() >= ARCEntryNameSize)
+		return false;
+
+	if (m_Offset + size > std::numeric_limits<uint32_t>::max())
+		return false;
+
+	ARCEntry& newEntry{ m_Entries.emplace_back(entry) };
+	newEntry.compressedSize = uint32_t(size);
+	newEntry.offset = uint32_t(m_Offset);
+
+	m_Stream.write(data, std::streamsize(size));
+	m_Offset += size;
+
+	return IsOpen();
+}
+
+bool powe::ARCWriter::Close()
+{
+	if (!m_Stream.is_open())
+		return false;
+
+	if (m_Entries.size() != m_EntryCount)
+	{
+		Logger::Error("ARC expected ", m_EntryCount, " entries but got ", m_Entries.size());
+		m_Stream.close();
+		return false;
+	}
+
+	std::vector<char> toc(ARCHeaderSize + m_Entries.size() * ARCEntrySize);
+	std::memcpy(toc.data(), ARCMagic, sizeof(ARCMagic));
+	WriteLE<uint16_t>(toc.data() + 4, ARCFile::SupportedVersion);
+	WriteLE<uint16_t>(toc.data() + 6, m_EntryCount);
+
+	for (size_t i = 0; i < m_Entries.size(); i++)
+	{
+		const auto& entry{ m_Entries[i] };
+		char* entryData{ toc.data() + ARCHeaderSize + i * ARCEntrySize };
+
+		std::memcpy(entryData, entry.name.data(), entry.name.size());
+
+		char* fields{ entryData + ARCEntryNameSize };
+		WriteLE<uint32_t>(fields, entry.typeHash);
+		WriteLE<uint32_t>(fields + 4, entry.compressedSize);
+		WriteLE<uint32_t>(fields + 8, (entry.decompressedSize & ARCDecompressedSizeMask) | entry.flags);
+		WriteLE<uint32_t>(fields + 12, entry.offset);
+	}
+
+	m_Stream.seekp(0);
+	m_Stream.write(toc.data(), std::streamsize(toc.size()));
+
+	const bool writeResult{ m_Stream.good() };
+	m_Stream.close();
+
+	return writeResult;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <fstream>
+
+class EntryCodec;
+
+namespace powe
+{
+	// One file inside an MT Framework ARC archive as it's described in the TOC
+	struct ARCEntry
+	{
+		std::string name; // path inside the archive without extension, separated by '\'
+		uint32_t typeHash{};
+		uint32_t compressedSize{};
+		uint32_t decompressedSize{};
+		uint32_t flags{}; // upper bits of the decompressed size field, kept as is
+		uint32_t offset{};
+
+		// name and type together are unique inside one archive
+		std::string GetKey() const;
+
+		// entries that weren't worth compressing are stored as is,
+		// equal sizes alone can't tell so the data has to be checked too
+		bool IsCompressed(const std::vector<char>& rawData) const;
+	};
+
+	/// <summary>
+	/// Reader for Dragon's Dogma ARC files (version 7, little endian).
+	/// Only the TOC is read on open, entry data stays on disk until asked for.
+	/// Keeps the file open so one instance shouldn't be shared between threads
+	/// </summary>
+	class ARCFile
+	{
+	public:
+
+		static constexpr uint16_t SupportedVersion{ 7 };
+
+		// nullopt if the file can't be read or isn't an ARC we understand
+		static std::optional<ARCFile> Open(const std::filesystem::path& arcPath);
+
+		const std::vector<ARCEntry>& GetEntries() const { return m_Entries; }
+		const std::filesystem::path& GetPath() const { return m_Path; }
+		uint16_t GetVersion() const { return m_Version; }
+
+		// Entry data exactly as it's stored, still compressed
+		std::vector<char> ReadRawEntry(const ARCEntry& entry) const;
+
+		// Entry data ready to use
+		bool ReadEntry(const ARCEntry& entry, const EntryCodec& codec, std::vector<char>& outData) const;
+
+		// Same as ReadEntry for data that was already read with ReadRawEntry
+		bool DecodeEntry(const ARCEntry& entry, std::vector<char> rawData, const EntryCodec& codec, std::vector<char>& outData) const;
+
+	private:
+
+		ARCFile() = default;
+
+		std::filesystem::path m_Path;
+		std::vector<ARCEntry> m_Entries;
+		mutable std::ifstream m_Stream;
+		uint16_t m_Version{};
+	};
+
+	/// <summary>
+	/// Streams an ARC file to disk. The number of entries has to be known up front,
+	/// entry data is written as it comes and the TOC is filled in on Close
+	/// </summary>
+	class ARCWriter
+	{
+	public:
+
+		ARCWriter(const std::filesystem::path& arcPath, uint16_t entryCount);
+
+		bool IsOpen() const { return m_Stream.is_open() && m_Stream.good(); }
+
+		// name, typeHash, flags and decompressedSize come from entry, the rest is filled in here
+		bool WriteEntry(const ARCEntry& entry, const char* data, size_t size);
+
+		bool Close();
+
+	private:
+
+		std::ofstream m_Stream;
+		std::vector<ARCEntry> m_Entries;
+		uint16_t m_EntryCount{};
+		uint64_t m_Offset{};
+	};
+}
+
@@ -0,0 +1,358 @@
+#include "ARCPacker.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+#include "EntryCodec.h"
+#include "CompressionPolicy.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+constexpr uint32_t DefaultEntryFlags{ 0x40000000 }; // what the game's own archives carry
+
+std::filesystem::path powe::GetUnpackedEntryPath(const ARCEntry& entry)
+{
+	std::string relativePath{ entry.GetKey() };
+	std::replace(relativePath.begin(), relativePath.end(), '\\', '/');
+
+	// a name from the archive must stay inside the folder it's unpacked to
+	const fs::path entryPath{ fs::path(relativePath).lexically_normal() };
+	if (entryPath.empty() || entryPath.has_root_path() || !entryPath.has_filename())
+		return {};
+
+	if (std::any_of(entryPath.begin(), entryPath.end(), [](const fs::path& part) { return part == ".."; }))
+		return {};
+
+	return entryPath;
+}
+
+bool powe::UnpackARC(const fs::path& arcPath, const fs::path& outFolder, const EntryCodec& codec, std::stop_token stopToken)
+{
+	const auto arcFile{ ARCFile::Open(arcPath) };
+	if (!arcFile)
+		return false;
+
+	std::vector<char> entryData{};
+	fs::path lastCreatedFolder{};
+
+	try
+	{
+		for (const auto& entry : arcFile->GetEntries())
+		{
+			if (stopToken.stop_requested() || !arcFile->ReadEntry(entry, codec, entryData))
+				return false;
+
+			const fs::path relativePath{ GetUnpackedEntryPath(entry) };
+			if (relativePath.empty())
+			{
+				Logger::Error("Entry ", entry.GetKey(), " in ", arcPath, " points outside of the archive");
+				return false;
+			}
+
+			const fs::path entryPath{ outFolder / relativePath };
+
+			// entries of the same folder are usually next to each other
+			if (entryPath.parent_path() != lastCreatedFolder)
+			{
+				lastCreatedFolder = entryPath.parent_path();
+				fs::create_directories(lastCreatedFolder);
+			}
+
+			std::ofstream outFile(entryPath, std::ios::binary | std::ios::trunc);
+			outFile.write(entryData.data(), std::streamsize(entryData.size()));
+
+			if (!outFile.good())
+			{
+				Logger::Error("Failed to write ", entryPath);
+				return false;
+			}
+		}
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
+		return false;
+	}
+
+	return true;
+}
+
+bool powe::RepackARC(
+	const fs::path& folder,
+	const fs::path& arcPath,
+	const ARCFile& orderReference,
+	const EntryCodec& codec,
+	CompressionPolicy& compressionPolicy,
+	std::stop_token stopToken)
+{
+	struct PackEntry
+	{
+		ARCEntry entry;
+		fs::path filePath;
+		size_t order{};
+	};
+
+	std::unordered_map<std::string, size_t> referenceOrder{};
+	const auto& referenceEntries{ orderReference.GetEntries() };
+	for (size_t i = 0; i < referenceEntries.size(); i++)
+	{
+		referenceOrder.emplace(referenceEntries[i].GetKey(), i);
+	}
+
+	std::vector<PackEntry> packEntries{};
+
+	try
+	{
+		for (const auto& file : fs::recursive_directory_iterator(folder))
+		{
+			if (stopToken.stop_requested())
+				return false;
+
+			if (!file.is_regular_file())
+				continue;
+
+			// <name>.<TYPEHASH>, anything else wasn't unpacked by us
+			const std::string typeHex{ file.path().extension().string() };
+			PackEntry packEntry{};
+			if (typeHex.size() != 9 ||
+				std::from_chars(typeHex.data() + 1, typeHex.data() + typeHex.size(), packEntry.entry.typeHash, 16).ec != std::errc{})
+			{
+				Logger::Warning("Skipping ", file.path());
+				continue;
+			}
+
+			std::string name{ fs::relative(file.path(), folder).replace_extension().generic_string() };
+			std::replace(name.begin(), name.end(), '/', '\\');
+			packEntry.entry.name = std::move(name);
+			packEntry.entry.flags = DefaultEntryFlags;
+			packEntry.filePath = file.path();
+			packEntry.order = referenceEntries.size() + packEntries.size();
+
+			if (const auto findItr = referenceOrder.find(packEntry.entry.GetKey()); findItr != referenceOrder.end())
+			{
+				packEntry.order = findItr->second;
+				packEntry.entry.flags = referenceEntries[findItr->second].flags;
+			}
+
+			packEntries.emplace_back(std::move(packEntry));
+		}
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
+		return false;
+	}
+
+	if (packEntries.size() > std::numeric_limits<uint16_t>::max())
+	{
+		Logger::Error("Too many entries for one ARC: ", folder);
+		return false;
+	}
+
+	std::sort(packEntries.begin(), packEntries.end(), [](const PackEntry& lhs, const PackEntry& rhs)
+		{
+			return lhs.order < rhs.order;
+		});
+
+	ARCWriter arcWriter{ arcPath, uint16_t(packEntries.size()) };
+
+	std::vector<char> entryData{};
+	std::vector<char> compressedData{};
+
+	for (auto& packEntry : packEntries)
+	{
+		if (stopToken.stop_requested())
+			return false;
+
+		std::ifstream inFile(packEntry.filePath, std::ios::binary);
+		entryData.assign(std::istreambuf_iterator<char>(inFile), {});
+
+		packEntry.entry.decompressedSize = uint32_t(entryData.size());
+
+		if (!compressionPolicy.Encode(codec, packEntry.entry.typeHash, entryData, compressedData))
+		{
+			Logger::Error("Failed to compress ", packEntry.filePath);
+			return false;
+		}
+
+		if (!arcWriter.WriteEntry(packEntry.entry, compressedData.data(), compressedData.size()))
+		{
+			Logger::Error("Failed to write ", packEntry.entry.name, " to ", arcPath);
+			return false;
+		}
+	}
+
+	return arcWriter.Close();
+}
+
+bool powe::MergeARCInMemory(
+	const fs::path& mainArcPath,
+	const std::vector<std::string>& modArcPaths,
+	const fs::path& outArcPath,
+	const EntryCodec& codec,
+	CompressionPolicy& compressionPolicy,
+	const std::function<bool(const ARCEntry&)>& ignoreEntry,
+	std::stop_token stopToken)
+{
+	const auto mainFile{ ARCFile::Open(mainArcPath) };
+	if (!mainFile)
+		return false;
+
+	const auto& mainEntries{ mainFile->GetEntries() };
+
+	std::unordered_map<std::string, size_t> mainIndices{};
+	mainIndices.reserve(mainEntries.size());
+	for (size_t i = 0; i < mainEntries.size(); i++)
+	{
+		mainIndices.emplace(mainEntries[i].GetKey(), i);
+	}
+
+	// index into mainEntries and the mod's version of it
+	using ChangedEntries = std::vector<std::pair<size_t, std::vector<char>>>;
+
+	auto findChangedEntries = [&mainArcPath, &mainEntries, &mainIndices, &codec, &ignoreEntry, &stopToken](std::string_view modArcPath)
+		-> std::optional<ChangedEntries>
+		{
+			// every task reads through its own stream, ARCFile can't be shared
+			const auto modFile{ ARCFile::Open(modArcPath) };
+			const auto mainReader{ ARCFile::Open(mainArcPath) };
+			if (!modFile || !mainReader)
+				return std::nullopt;
+
+			ChangedEntries changedEntries{};
+			std::vector<char> mainData{};
+			std::vector<char> modData{};
+
+			for (const auto& entry : modFile->GetEntries())
+			{
+				if (stopToken.stop_requested())
+					return std::nullopt;
+
+				const auto findItr{ mainIndices.find(entry.GetKey()) };
+				if (findItr == mainIndices.end() || ignoreEntry(entry))
+					continue;
+
+				const ARCEntry& mainEntry{ mainEntries[findItr->second] };
+
+				std::vector<char> modRawData{ modFile->ReadRawEntry(entry) };
+				std::vector<char> mainRawData{ mainReader->ReadRawEntry(mainEntry) };
+
+				// same bytes on disk, no need to inflate anything
+				if (modRawData == mainRawData)
+					continue;
+
+				if (!modFile->DecodeEntry(entry, std::move(modRawData), codec, modData) ||
+					!mainReader->DecodeEntry(mainEntry, std::move(mainRawData), codec, mainData))
+					return std::nullopt;
+
+				if (modData != mainData)
+					changedEntries.emplace_back(findItr->second, std::move(modData));
+			}
+
+			return changedEntries;
+		};
+
+	std::vector<std::future<std::optional<ChangedEntries>>> modFutures{};
+	modFutures.reserve(modArcPaths.size());
+	for (const auto& modArcPath : modArcPaths)
+	{
+		modFutures.emplace_back(ThreadPool::Enqueue(findChangedEntries, std::string_view(modArcPath)));
+	}
+
+	std::vector<ChangedEntries> modsChangedEntries{};
+	modsChangedEntries.reserve(modArcPaths.size());
+	bool readResult{ true };
+	for (auto& future : modFutures)
+	{
+		auto changedEntries{ future.get() };
+		if (!changedEntries)
+		{
+			readResult = false;
+			continue;
+		}
+
+		modsChangedEntries.emplace_back(std::move(*changedEntries));
+	}
+
+	if (!readResult)
+		return false;
+
+	// mods are in priority order so whoever comes last wins
+	std::vector<const std::vector<char>*> winners(mainEntries.size());
+	for (const auto& changedEntries : modsChangedEntries)
+	{
+		for (const auto& [mainIndex, data] : changedEntries)
+		{
+			winners[mainIndex] = &data;
+		}
+	}
+
+	// write next to the output and rename so a failed merge never leaves half an archive behind
+	fs::path partialPath{ outArcPath };
+	partialPath += ".partial";
+
+	bool writeResult{ true };
+
+	{
+		ARCWriter arcWriter{ partialPath, uint16_t(mainEntries.size()) };
+		writeResult = arcWriter.IsOpen();
+
+		std::vector<char> compressedData{};
+
+		for (size_t i = 0; i < mainEntries.size() && writeResult; i++)
+		{
+			if (stopToken.stop_requested())
+			{
+				writeResult = false;
+				break;
+			}
+
+			if (const std::vector<char>* winnerData{ winners[i] })
+			{
+				ARCEntry entry{ mainEntries[i] };
+				entry.decompressedSize = uint32_t(winnerData->size());
+
+				if (!compressionPolicy.Encode(codec, entry.typeHash, *winnerData, compressedData))
+				{
+					Logger::Error("Failed to compress ", entry.name);
+					writeResult = false;
+					break;
+				}
+
+				writeResult = arcWriter.WriteEntry(entry, compressedData.data(), compressedData.size());
+			}
+			else
+			{
+				const std::vector<char> rawData{ mainFile->ReadRawEntry(mainEntries[i]) };
+				writeResult = rawData.size() == mainEntries[i].compressedSize &&
+					arcWriter.WriteEntry(mainEntries[i], rawData.data(), rawData.size());
+			}
+		}
+
+		writeResult = arcWriter.Close() && writeResult;
+	}
+
+	std::error_code errorCode{};
+	if (writeResult)
+	{
+		fs::rename(partialPath, outArcPath, errorCode);
+		if (!errorCode)
+			return true;
+
+		Logger::Error(errorCode.message(), ": ", outArcPath);
+	}
+	else if (!stopToken.stop_requested())
+	{
+		Logger::Error("Failed to write ", outArcPath);
+	}
+
+	fs::remove(partialPath, errorCode);
+	return false;
+}
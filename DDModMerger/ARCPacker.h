@@ -0,0 +1,54 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "ARCFile.h"
+
+class EntryCodec;
+class CompressionPolicy;
+
+// In process replacement for ARCTool's unpack and repack.
+// Every entry is written as <name>.<TYPEHASH> so the type survives the round trip
+// without an extension table.
+namespace powe
+{
+	// Every function here checks stopToken between entries and gives up with false once it's triggered
+
+	// Unpack every entry of arcPath into outFolder
+	bool UnpackARC(
+		const std::filesystem::path& arcPath,
+		const std::filesystem::path& outFolder,
+		const EntryCodec& codec,
+		std::stop_token stopToken = {});
+
+	// Pack every file under folder into arcPath.
+	// Entries that exist in orderReference keep its order and flags, new ones go at the end
+	bool RepackARC(
+		const std::filesystem::path& folder,
+		const std::filesystem::path& arcPath,
+		const ARCFile& orderReference,
+		const EntryCodec& codec,
+		CompressionPolicy& compressionPolicy,
+		std::stop_token stopToken = {});
+
+	// Merge without touching the disk in between: entries the mods change are kept in memory,
+	// later mods win, and the result is written to outArcPath in the main file's order.
+	// Untouched entries are copied over still compressed.
+	// Like the on-disk merge, entries the main file doesn't have are left out
+	bool MergeARCInMemory(
+		const std::filesystem::path& mainArcPath,
+		const std::vector<std::string>& modArcPaths,
+		const std::filesystem::path& outArcPath,
+		const EntryCodec& codec,
+		CompressionPolicy& compressionPolicy,
+		const std::function<bool(const ARCEntry&)>& ignoreEntry,
+		std::stop_token stopToken = {});
+
+	// Where the entry goes relative to the unpack folder, empty when its name is rooted or climbs out with ..
+	std::filesystem::path GetUnpackedEntryPath(const ARCEntry& entry);
+}
+
@@ -0,0 +1,215 @@
+#include "ARCToolBatcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include "Logger.h"
+#include "ProcessRunner.h"
+#include "ThreadPoolMetrics.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// how long the first archive of a batch waits for others to join
+	constexpr auto CollectWindow{ std::chrono::milliseconds(25) };
+
+	// Windows stops at 32767 characters, the rest is room for the command itself
+	constexpr size_t MaxItemsLength{ 30000 };
+
+	// ARCTool gets at least this long, past MinARCToolThroughput bytes a second bigger batches get more
+	constexpr std::chrono::minutes MinARCToolTimeout{ 3 };
+	constexpr uint64_t MinARCToolThroughput{ 1ull << 20 };
+
+	// An archive, or everything in a folder that's about to be repacked
+	uint64_t GetItemSize(const fs::path& itemPath)
+	{
+		std::error_code errorCode{};
+		if (!fs::is_directory(itemPath, errorCode))
+			return fs::file_size(itemPath, errorCode);
+
+		uint64_t size{};
+		for (auto itr = fs::recursive_directory_iterator(itemPath, errorCode); itr != fs::recursive_directory_iterator(); itr.increment(errorCode))
+		{
+			if (itr->is_regular_file(errorCode))
+				size += itr->file_size(errorCode);
+		}
+
+		return size;
+	}
+
+	// What ARCTool writes for an item, the folder for an archive and the archive for a folder
+	fs::path GetOutputPath(const fs::path& itemPath)
+	{
+		std::error_code errorCode{};
+		if (fs::is_directory(itemPath, errorCode))
+		{
+			fs::path archivePath{ itemPath };
+			archivePath += ".arc";
+			return archivePath;
+		}
+
+		return itemPath.parent_path() / itemPath.stem();
+	}
+}
+
+struct ARCToolBatcher::Batch
+{
+	struct Item
+	{
+		fs::path path;
+		std::stop_token stopToken;
+		bool succeeded{};
+	};
+
+	std::vector<Item> items;
+	size_t itemsLength{};
+	bool done{};
+};
+
+ARCToolBatcher::ARCToolBatcher(std::vector<std::string> arctoolCommand, uint32_t maxBatchSize)
+	: m_ARCToolCommand(std::move(arctoolCommand))
+	, m_MaxBatchSize(std::max(1u, maxBatchSize))
+{
+}
+
+bool ARCToolBatcher::Run(const fs::path& itemPath, std::stop_token stopToken)
+{
+	std::unique_lock lock(m_Mutex);
+
+	const bool isLeader{ !m_OpenBatch };
+	if (isLeader)
+		m_OpenBatch = std::make_shared<Batch>();
+
+	const std::shared_ptr<Batch> batch{ m_OpenBatch };
+	const size_t itemIndex{ batch->items.size() };
+
+	std::string absolutePath{ fs::absolute(itemPath).string() };
+	batch->itemsLength += absolutePath.size() + 3; // quotes and a space
+	batch->items.push_back({ std::move(absolutePath), stopToken });
+
+	// a full batch takes nothing more, the next archive starts a new one
+	const auto isFull = [this, &batch]()
+		{
+			return batch->items.size() >= m_MaxBatchSize || batch->itemsLength >= MaxItemsLength;
+		};
+
+	if (isFull())
+	{
+		if (m_OpenBatch == batch)
+			m_OpenBatch.reset();
+
+		m_BatchCV.notify_all();
+	}
+
+	if (!isLeader)
+	{
+		const ThreadPoolMetrics::BlockScope blockScope{};
+		m_BatchCV.wait(lock, [&batch]() { return batch->done; });
+		return batch->items[itemIndex].succeeded;
+	}
+
+	{
+		const ThreadPoolMetrics::BlockScope blockScope{};
+		m_BatchCV.wait_for(lock, CollectWindow, isFull);
+	}
+
+	if (m_OpenBatch == batch)
+		m_OpenBatch.reset();
+
+	// nobody adds to it anymore, the items can be read without the lock
+	lock.unlock();
+
+	// everyone else in the batch is waiting on it, they have to hear back even when it throws
+	try
+	{
+		RunBatch(*batch);
+	}
+	catch (const std::exception& e)
+	{
+		Logger::Error("ARCTool batch failed: ", e.what());
+		MarkFailed(*batch);
+	}
+	catch (...)
+	{
+		Logger::Error("ARCTool batch failed");
+		MarkFailed(*batch);
+	}
+
+	lock.lock();
+
+	batch->done = true;
+	m_BatchCV.notify_all();
+
+	return batch->items[itemIndex].succeeded;
+}
+
+void ARCToolBatcher::MarkFailed(Batch& batch)
+{
+	for (auto& item : batch.items)
+	{
+		item.succeeded = false;
+	}
+}
+
+void ARCToolBatcher::RunBatch(Batch& batch) const
+{
+	std::vector<std::string> args{ m_ARCToolCommand };
+	args.reserve(args.size() + batch.items.size());
+
+	uint64_t batchSize{};
+
+	// what was there before, a repack overwrites the copy of the archive it was unpacked from
+	std::vector<fs::file_time_type> lastWriteTimes{};
+	lastWriteTimes.reserve(batch.items.size());
+
+	for (const auto& item : batch.items)
+	{
+		args.emplace_back(item.path.string());
+		batchSize += GetItemSize(item.path);
+
+		std::error_code errorCode{};
+		lastWriteTimes.emplace_back(fs::last_write_time(GetOutputPath(item.path), errorCode));
+	}
+
+	// ARCTool is only stopped when everyone in the batch cancelled, the others still want their archives
+	std::stop_source batchStopSource{};
+	std::atomic<size_t> cancelledCount{};
+
+	std::vector<std::unique_ptr<std::stop_callback<std::function<void()>>>> stopCallbacks{};
+	stopCallbacks.reserve(batch.items.size());
+	for (const auto& item : batch.items)
+	{
+		stopCallbacks.emplace_back(std::make_unique<std::stop_callback<std::function<void()>>>(item.stopToken,
+			[&batch, &batchStopSource, &cancelledCount]()
+			{
+				if (cancelledCount.fetch_add(1, std::memory_order_relaxed) + 1 == batch.items.size())
+					batchStopSource.request_stop();
+			}));
+	}
+
+	if (batch.items.size() > 1)
+		Logger::Debug("ARCTool gets a batch of ", batch.items.size(), " archives");
+
+	const std::chrono::milliseconds timeout{ std::max<std::chrono::milliseconds>(
+		MinARCToolTimeout,
+		std::chrono::seconds(batchSize / MinARCToolThroughput)) };
+
+	const auto result{ ProcessRunner::Run(args, timeout, "ARCTool", batchStopSource.get_token()) };
+
+	// The exit code is for the whole batch and doesn't say which archive broke. An output that was
+	// only partly written still has a new write time, so nothing from a batch that failed is trusted
+	if (batch.items.size() > 1 && result.started && !result.cancelled && !result.timedOut && result.exitCode != 0)
+		Logger::Warning("None of the ", batch.items.size(), " archives of the failed ARCTool batch are used");
+
+	// a clean exit still doesn't mean every archive was written, each one is checked on its own
+	for (size_t i = 0; i < batch.items.size(); i++)
+	{
+		std::error_code errorCode{};
+		const fs::file_time_type lastWriteTime{ fs::last_write_time(GetOutputPath(batch.items[i].path), errorCode) };
+
+		batch.items[i].succeeded = result.Succeeded() && !errorCode && lastWriteTime != lastWriteTimes[i];
+	}
+}
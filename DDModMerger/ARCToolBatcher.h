@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Hands ARCTool many archives per start instead of one, every start loads its extension data all over again.
+/// The first archive that comes in waits a moment for others, then ARCTool gets all of them on one command line
+/// and everyone who was waiting learns whether their own archive came out.
+/// How many batches run at once is up to ProcessRunner's cap
+/// </summary>
+class ARCToolBatcher
+{
+public:
+
+	// arctoolCommand is ARCTool and whatever has to start it. maxBatchSize 1 starts ARCTool for every archive
+	ARCToolBatcher(std::vector<std::string> arctoolCommand, uint32_t maxBatchSize);
+
+	ARCToolBatcher(const ARCToolBatcher&) = delete;
+	ARCToolBatcher& operator=(const ARCToolBatcher&) = delete;
+
+	// Unpacks an archive into a folder next to it or repacks a folder into an archive next to it.
+	// Blocks until the batch it went into is done, false when ARCTool didn't write the output
+	bool Run(const std::filesystem::path& itemPath, std::stop_token stopToken = {});
+
+private:
+
+	struct Batch;
+
+	void RunBatch(Batch& batch) const;
+	static void MarkFailed(Batch& batch);
+
+	std::vector<std::string> m_ARCToolCommand;
+	uint32_t m_MaxBatchSize;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_BatchCV;
+	std::shared_ptr<Batch> m_OpenBatch; // the one still taking archives
+};
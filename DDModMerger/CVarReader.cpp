@@ -51,6 +51,11 @@ std::string CVarReader::ReadCVar(const std::string& cVar) const
 	return {};
 }
 
+bool CVarReader::HasCVar(const std::string& cVar) const
+{
+	return m_cVars.contains(cVar);
+}
+
 bool CVarReader::CheckArgs() const
 {
 	return m_cVars.size() > 0;
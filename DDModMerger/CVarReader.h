@@ -12,6 +12,7 @@ public:
 	void ParseArguments(int argc, char* argv[]);
 
 	std::string ReadCVar(const std::string& cVar) const;
+	bool HasCVar(const std::string& cVar) const;
 	
 	bool CheckArgs() const;
 
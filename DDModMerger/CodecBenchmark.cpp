@@ -0,0 +1,210 @@
+#include "CodecBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <limits>
+
+#include "ARCFile.h"
+#include "EntryCodec.h"
+
+namespace fs = std::filesystem;
+
+// Don't let a full game folder eat all the memory, this is plenty to get a real size distribution
+constexpr size_t MaxBenchmarkBytes{ size_t(512) << 20 };
+
+struct BenchmarkEntry
+{
+	powe::ARCEntry entry;
+	std::vector<char> data{};
+};
+
+std::vector<BenchmarkEntry> LoadBenchmarkEntries(std::string_view benchmarkPath, const EntryCodec& referenceCodec)
+{
+	std::vector<fs::path> arcPaths{};
+
+	if (fs::is_directory(benchmarkPath))
+	{
+		for (const auto& file : fs::recursive_directory_iterator(benchmarkPath, fs::directory_options::skip_permission_denied))
+		{
+			if (file.is_regular_file() && file.path().extension() == ".arc")
+				arcPaths.emplace_back(file.path());
+		}
+	}
+	else
+	{
+		arcPaths.emplace_back(benchmarkPath);
+	}
+
+	std::vector<BenchmarkEntry> entries{};
+	size_t totalBytes{};
+
+	for (const auto& arcPath : arcPaths)
+	{
+		const auto arcFile{ powe::ARCFile::Open(arcPath) };
+		if (!arcFile)
+			continue;
+
+		for (const auto& entry : arcFile->GetEntries())
+		{
+			BenchmarkEntry benchmarkEntry{ entry };
+			if (!arcFile->ReadEntry(entry, referenceCodec, benchmarkEntry.data))
+				continue;
+
+			totalBytes += benchmarkEntry.data.size();
+			entries.emplace_back(std::move(benchmarkEntry));
+
+			if (totalBytes >= MaxBenchmarkBytes)
+				return entries;
+		}
+	}
+
+	return entries;
+}
+
+void PrintSizeDistribution(const std::vector<BenchmarkEntry>& entries)
+{
+	std::vector<size_t> sizes{};
+	sizes.reserve(entries.size());
+	for (const auto& entry : entries)
+	{
+		sizes.emplace_back(entry.data.size());
+	}
+
+	std::sort(sizes.begin(), sizes.end());
+
+	const size_t totalBytes{ std::accumulate(sizes.begin(), sizes.end(), size_t{}) };
+	auto percentile = [&sizes](double p) { return sizes[size_t(double(sizes.size() - 1) * p)]; };
+
+	std::cout << "Entries: " << sizes.size()
+		<< "  Total: " << totalBytes / (1024.0 * 1024.0) << " MB"
+		<< "  p50: " << percentile(0.5)
+		<< "  p90: " << percentile(0.9)
+		<< "  p99: " << percentile(0.99)
+		<< "  max: " << sizes.back() << " bytes\n";
+}
+
+// Write an ARC with the compressed entries, open it again and check every entry comes back the same
+bool ValidateARC(
+	const std::vector<BenchmarkEntry>& entries,
+	const std::vector<std::vector<char>>& compressedEntries,
+	const EntryCodec& codec)
+{
+	const fs::path arcPath{ fs::temp_directory_path() / ("ddmodmerger_benchmark_" + std::string(codec.GetName()) + ".arc") };
+	const size_t entryCount{ std::min(entries.size(), size_t(std::numeric_limits<uint16_t>::max())) };
+
+	{
+		powe::ARCWriter arcWriter{ arcPath, uint16_t(entryCount) };
+		for (size_t i = 0; i < entryCount; i++)
+		{
+			powe::ARCEntry entry{ entries[i].entry };
+			entry.name = "benchmark\\" + std::to_string(i);
+			entry.decompressedSize = uint32_t(entries[i].data.size());
+
+			if (!arcWriter.WriteEntry(entry, compressedEntries[i].data(), compressedEntries[i].size()))
+				return false;
+		}
+
+		if (!arcWriter.Close())
+			return false;
+	}
+
+	bool validResult{ true };
+
+	if (const auto arcFile{ powe::ARCFile::Open(arcPath) }; arcFile && arcFile->GetEntries().size() == entryCount)
+	{
+		std::vector<char> data{};
+		for (size_t i = 0; i < entryCount && validResult; i++)
+		{
+			validResult = arcFile->ReadEntry(arcFile->GetEntries()[i], codec, data) && data == entries[i].data;
+		}
+	}
+	else
+	{
+		validResult = false;
+	}
+
+	std::error_code errorCode{};
+	fs::remove(arcPath, errorCode);
+
+	return validResult;
+}
+
+void BenchmarkCodec(const std::vector<BenchmarkEntry>& entries, const EntryCodec& codec, int level)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	std::vector<std::vector<char>> compressedEntries(entries.size());
+	size_t rawBytes{};
+	size_t compressedBytes{};
+	bool codecResult{ true };
+
+	const auto compressStart{ Clock::now() };
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		codecResult &= codec.Compress(entries[i].data.data(), entries[i].data.size(), level, compressedEntries[i]);
+		rawBytes += entries[i].data.size();
+		compressedBytes += compressedEntries[i].size();
+	}
+	const std::chrono::duration<double> compressElapsed{ Clock::now() - compressStart };
+
+	std::vector<char> decompressed{};
+	const auto decompressStart{ Clock::now() };
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		codecResult &= codec.Decompress(compressedEntries[i].data(), compressedEntries[i].size(), entries[i].data.size(), decompressed);
+	}
+	const std::chrono::duration<double> decompressElapsed{ Clock::now() - decompressStart };
+
+	const double rawMB{ double(rawBytes) / (1024.0 * 1024.0) };
+	const bool validARC{ codecResult && ValidateARC(entries, compressedEntries, codec) };
+
+	std::cout << std::left << std::setw(12) << codec.GetName()
+		<< std::setw(7) << level
+		<< std::setw(16) << rawMB / compressElapsed.count()
+		<< std::setw(16) << rawMB / decompressElapsed.count()
+		<< std::setw(10) << double(compressedBytes) / double(std::max(rawBytes, size_t(1)))
+		<< (validARC ? "ok" : "FAILED") << '\n';
+}
+
+void RunCodecBenchmark(std::string_view benchmarkPath)
+{
+	const auto codecNames{ EntryCodec::GetAvailableCodecs() };
+	if (codecNames.empty())
+	{
+		std::cerr << "Error: No entry codec compiled in, define POWE_WITH_ZLIB, POWE_WITH_ZLIB_NG or POWE_WITH_LIBDEFLATE\n";
+		return;
+	}
+
+	const auto referenceCodec{ EntryCodec::Create() };
+	const auto entries{ LoadBenchmarkEntries(benchmarkPath, *referenceCodec) };
+	if (entries.empty())
+	{
+		std::cerr << "Error: No ARC entries found in " << benchmarkPath << '\n';
+		return;
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	PrintSizeDistribution(entries);
+
+	std::cout << '\n'
+		<< std::left << std::setw(12) << "Codec"
+		<< std::setw(7) << "Level"
+		<< std::setw(16) << "Compress MB/s"
+		<< std::setw(16) << "Inflate MB/s"
+		<< std::setw(10) << "Ratio"
+		<< "ARC" << '\n';
+
+	for (const auto& codecName : codecNames)
+	{
+		const auto codec{ EntryCodec::Create(codecName) };
+
+		for (const int level : { 1, EntryCodec::DefaultLevel, codec->GetMaxLevel() })
+		{
+			BenchmarkCodec(entries, *codec, level);
+		}
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string_view>
+
+/// <summary>
+/// Inflates the entries of real ARC files (one file or every .arc under a folder)
+/// and measures every compiled in EntryCodec on them: compress and decompress MB/s,
+/// compression ratio, and whether an ARC written with that backend still reads back the same
+/// </summary>
+void RunCodecBenchmark(std::string_view benchmarkPath);
+
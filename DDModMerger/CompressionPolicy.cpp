@@ -0,0 +1,74 @@
+#include "CompressionPolicy.h"
+
+#include "EntryCodec.h"
+
+// Anything that doesn't shrink below this isn't worth inflating every time the game loads it
+constexpr double IncompressibleRatio{ 0.95 };
+
+// The game inflates every entry, what isn't compressed still has to be a zlib stream, just with stored blocks
+constexpr int StoredLevel{ 0 };
+
+// Small entries don't say much about their type
+constexpr size_t MinSizeToJudgeType{ 4096 };
+
+std::string_view GetCompressionProfileName(CompressionProfile profile)
+{
+	switch (profile)
+	{
+	case CompressionProfile::Store:
+		return "store";
+	case CompressionProfile::Fast:
+		return "fast";
+	case CompressionProfile::Max:
+		return "max";
+	default:
+		return "default";
+	}
+}
+
+CompressionProfile ParseCompressionProfile(std::string_view profileName)
+{
+	if (profileName == "store")
+		return CompressionProfile::Store;
+	if (profileName == "fast")
+		return CompressionProfile::Fast;
+	if (profileName == "max")
+		return CompressionProfile::Max;
+
+	return CompressionProfile::Default;
+}
+
+CompressionPolicy::CompressionPolicy(CompressionProfile profile)
+	: m_Profile(profile)
+{
+}
+
+bool CompressionPolicy::Encode(
+	const EntryCodec& codec,
+	uint32_t typeHash,
+	const std::vector<char>& data,
+	std::vector<char>& outData)
+{
+	if (m_Profile == CompressionProfile::Store || m_IncompressibleTypes.contains(typeHash))
+		return codec.Compress(data.data(), data.size(), StoredLevel, outData);
+
+	int level{ EntryCodec::DefaultLevel };
+	if (m_Profile == CompressionProfile::Fast)
+		level = 1;
+	else if (m_Profile == CompressionProfile::Max)
+		level = codec.GetMaxLevel();
+
+	if (!codec.Compress(data.data(), data.size(), level, outData))
+		return false;
+
+	if (double(outData.size()) >= double(data.size()) * IncompressibleRatio)
+	{
+		if (data.size() >= MinSizeToJudgeType)
+			m_IncompressibleTypes.insert(typeHash);
+
+		return codec.Compress(data.data(), data.size(), StoredLevel, outData);
+	}
+
+	return true;
+}
+
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+class EntryCodec;
+
+enum class CompressionProfile
+{
+	Store,
+	Fast,
+	Default,
+	Max
+};
+
+std::string_view GetCompressionProfileName(CompressionProfile profile);
+CompressionProfile ParseCompressionProfile(std::string_view profileName);
+
+/// <summary>
+/// Decides how each entry is written on repack. Store writes stored blocks only,
+/// the other profiles only pick the level. Entry types that turn out to be already
+/// compressed (barely shrink) are remembered and stored from then on.
+/// Every entry comes out as a zlib stream, the game inflates them all.
+/// One policy per archive, entries go through it in the archive's order so the output only depends on the input
+/// </summary>
+class CompressionPolicy
+{
+public:
+
+	explicit CompressionPolicy(CompressionProfile profile);
+
+	// Fills outData with the zlib stream that goes into the ARC, compressed or in stored blocks
+	bool Encode(
+		const EntryCodec& codec,
+		uint32_t typeHash,
+		const std::vector<char>& data,
+		std::vector<char>& outData);
+
+	CompressionProfile GetProfile() const { return m_Profile; }
+
+private:
+
+	std::unordered_set<uint32_t> m_IncompressibleTypes;
+
+	CompressionProfile m_Profile;
+};
+
@@ -0,0 +1,152 @@
+#include "ConflictAnalyzer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+#include "ARCFile.h"
+#include "ThreadPool.h"
+#include "FrameScheduler.h"
+
+void ConflictAnalyzer::AnalyzeAsync(
+	const powe::details::DirectoryTree& dirTree,
+	const powe::details::ModsOverwriteOrder& overwriteOrder)
+{
+	const uint32_t generation{ m_Generation.fetch_add(1, std::memory_order_acq_rel) + 1 };
+
+	for (const auto& [fileName, pathToMods] : overwriteOrder)
+	{
+		const auto findItr = dirTree.find(fileName);
+		if (findItr == dirTree.end())
+			continue;
+
+		// the report doesn't depend on the mod order so sort to keep the cache valid after reordering
+		std::vector<std::string> sortedMods{ pathToMods };
+		std::sort(sortedMods.begin(), sortedMods.end());
+
+		MergeManifest::Inputs inputs{ MergeManifest::CreateInputs(findItr->second, sortedMods) };
+
+		{
+			std::scoped_lock lock(m_ReportsMutex);
+			if (const auto cacheItr = m_Reports.find(fileName);
+				cacheItr != m_Reports.end() && cacheItr->second.inputs == inputs)
+				continue;
+
+			m_Reports.erase(fileName);
+		}
+
+		m_ActiveTasks.fetch_add(1, std::memory_order_relaxed);
+
+		// copy everything, the UI is free to reorder its own list while we work
+		auto analyze = [this, generation, fileName, mainFilePath = findItr->second,
+			sortedMods = std::move(sortedMods), inputs = std::move(inputs)]()
+			{
+				if (generation == m_Generation.load(std::memory_order_acquire))
+				{
+					auto report{ Analyze(mainFilePath, sortedMods) };
+
+					{
+						std::scoped_lock lock(m_ReportsMutex);
+						m_Reports[fileName] = CachedReport{ inputs, std::move(report) };
+					}
+
+					FrameScheduler::Wake();
+				}
+
+				m_ActiveTasks.fetch_sub(1, std::memory_order_relaxed);
+			};
+
+		ThreadPool::EnqueueDetach(analyze);
+	}
+}
+
+std::shared_ptr<const ConflictAnalyzer::Report> ConflictAnalyzer::GetReport(const std::string& fileName) const
+{
+	std::scoped_lock lock(m_ReportsMutex);
+
+	if (const auto findItr = m_Reports.find(fileName); findItr != m_Reports.end())
+		return findItr->second.report;
+
+	return nullptr;
+}
+
+bool ConflictAnalyzer::IsFinished() const
+{
+	return m_ActiveTasks.load(std::memory_order_relaxed) == 0;
+}
+
+std::shared_ptr<const ConflictAnalyzer::Report> ConflictAnalyzer::Analyze(
+	const std::string& mainFilePath,
+	const std::vector<std::string>& pathToMods)
+{
+	auto report{ std::make_shared<Report>() };
+	report->modPaths = pathToMods;
+	report->changedCountPerMod.resize(pathToMods.size());
+
+	const auto mainFile{ powe::ARCFile::Open(mainFilePath) };
+	if (!mainFile)
+	{
+		report->failed = true;
+		return report;
+	}
+
+	std::unordered_map<std::string, const powe::ARCEntry*> mainEntries{};
+	mainEntries.reserve(mainFile->GetEntries().size());
+	for (const auto& entry : mainFile->GetEntries())
+	{
+		mainEntries.emplace(entry.GetKey(), &entry);
+	}
+
+	std::unordered_map<std::string, size_t> entryIndices{};
+
+	for (uint32_t modIndex = 0; modIndex < uint32_t(pathToMods.size()); modIndex++)
+	{
+		const auto modFile{ powe::ARCFile::Open(pathToMods[modIndex]) };
+		if (!modFile)
+		{
+			report->failed = true;
+			continue;
+		}
+
+		for (const auto& entry : modFile->GetEntries())
+		{
+			std::string key{ entry.GetKey() };
+
+			const auto mainItr = mainEntries.find(key);
+			const bool inMainFile{ mainItr != mainEntries.end() };
+
+			// Mods often ship untouched copies of the main file's entries, those aren't changes.
+			// Only read the data when the sizes can't tell them apart
+			if (inMainFile)
+			{
+				const auto& mainEntry{ *mainItr->second };
+				if (mainEntry.compressedSize == entry.compressedSize &&
+					mainEntry.decompressedSize == entry.decompressedSize &&
+					mainFile->ReadRawEntry(mainEntry) == modFile->ReadRawEntry(entry))
+					continue;
+			}
+
+			auto [indexItr, inserted] = entryIndices.try_emplace(std::move(key), report->entries.size());
+			if (inserted)
+			{
+				report->entries.emplace_back(EntryConflict{ entry.name, entry.typeHash, inMainFile });
+			}
+
+			auto& conflict{ report->entries[indexItr->second] };
+			conflict.modIndices.emplace_back(modIndex);
+			report->changedCountPerMod[modIndex]++;
+
+			if (conflict.modIndices.size() == 2)
+				report->conflictCount++;
+		}
+	}
+
+	// collisions first so the UI can show them on top
+	std::stable_sort(report->entries.begin(), report->entries.end(),
+		[](const EntryConflict& lhs, const EntryConflict& rhs)
+		{
+			return lhs.modIndices.size() > rhs.modIndices.size();
+		});
+
+	return report;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "Types.h"
+#include "MergeManifest.h"
+
+/// <summary>
+/// Reads the ARC TOC of the main file and every mod that overwrites it in the background
+/// and finds out which entries each mod actually changes and where mods collide with each other
+/// </summary>
+class ConflictAnalyzer
+{
+public:
+
+	struct EntryConflict
+	{
+		std::string entryName;
+		uint32_t typeHash{};
+		bool inMainFile{};
+		std::vector<uint32_t> modIndices{}; // index into Report::modPaths
+	};
+
+	struct Report
+	{
+		std::vector<std::string> modPaths;
+		std::vector<EntryConflict> entries; // every entry at least one mod changes
+		std::vector<uint32_t> changedCountPerMod;
+		uint32_t conflictCount{}; // entries changed by more than one mod
+		bool failed{};
+	};
+
+	void AnalyzeAsync(
+		const powe::details::DirectoryTree& dirTree,
+		const powe::details::ModsOverwriteOrder& overwriteOrder);
+
+	// nullptr while the file is still being analyzed
+	std::shared_ptr<const Report> GetReport(const std::string& fileName) const;
+
+	bool IsFinished() const;
+
+private:
+
+	struct CachedReport
+	{
+		MergeManifest::Inputs inputs;
+		std::shared_ptr<const Report> report;
+	};
+
+	static std::shared_ptr<const Report> Analyze(
+		const std::string& mainFilePath,
+		const std::vector<std::string>& pathToMods);
+
+	std::unordered_map<std::string, CachedReport> m_Reports;
+	mutable std::mutex m_ReportsMutex;
+
+	std::atomic_uint32_t m_Generation{};
+	std::atomic_int32_t m_ActiveTasks{};
+};
+
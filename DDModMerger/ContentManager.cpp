@@ -1,13 +1,134 @@
 #include "ContentManager.h"
 
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
+#include <iterator>
+#include <mutex>
 
 #include "utils.h"
 #include "ThreadPool.h"
+#include "Tracer.h"
+#include "IOThrottle.h"
+#include "FrameScheduler.h"
+#include "Logger.h"
+#include "LowFrequencyThreadPool.h"
 
 namespace fs = std::filesystem;
 
+constexpr char ModFingerprintsFilePath[] = "./cache/modFingerprints.json";
+
+// how often the UI gets a new partial result while mods are scanned
+constexpr auto PartialPublishInterval{ std::chrono::milliseconds(100) };
+
+namespace
+{
+	// the mod index of every path in a ModsOverwriteOrder, in the same order
+	using ModIndices = std::unordered_map<std::string, std::vector<uint32_t>>;
+
+	// Puts one mod's files in at the place its index says, the other mods keep their order
+	void InsertModFiles(
+		powe::details::ModsOverwriteOrder& modsOverwriteOrder,
+		ModIndices& modIndices,
+		uint32_t modIndex,
+		powe::details::DirectoryTree&& fileMap)
+	{
+		for (auto& [fileName, path] : fileMap)
+		{
+			auto& paths{ modsOverwriteOrder[fileName] };
+			auto& indices{ modIndices[fileName] };
+
+			const auto indexItr{ std::upper_bound(indices.begin(), indices.end(), modIndex) };
+			paths.insert(paths.begin() + (indexItr - indices.begin()), std::move(path));
+			indices.insert(indexItr, modIndex);
+		}
+	}
+
+	void EraseModFiles(
+		powe::details::ModsOverwriteOrder& modsOverwriteOrder,
+		ModIndices& modIndices,
+		uint32_t modIndex)
+	{
+		for (auto itr = modIndices.begin(); itr != modIndices.end();)
+		{
+			auto& indices{ itr->second };
+
+			const auto indexItr{ std::lower_bound(indices.begin(), indices.end(), modIndex) };
+			if (indexItr == indices.end() || *indexItr != modIndex)
+			{
+				++itr;
+				continue;
+			}
+
+			auto& paths{ modsOverwriteOrder[itr->first] };
+			paths.erase(paths.begin() + (indexItr - indices.begin()));
+			indices.erase(indexItr);
+
+			if (indices.empty())
+			{
+				modsOverwriteOrder.erase(itr->first);
+				itr = modIndices.erase(itr);
+			}
+			else
+			{
+				++itr;
+			}
+		}
+	}
+}
+
+struct ContentManager::ScanState
+{
+	// The order the folders are found in is the order the mods overwrite each other
+	uint32_t AddModPath(const std::string& modPath)
+	{
+		std::scoped_lock lock(mutex);
+
+		const uint32_t modIndex{ modCount.fetch_add(1, std::memory_order_relaxed) };
+		modPathIndices[modPath] = modIndex;
+		return modIndex;
+	}
+
+	// Puts one mod's files in, at the place its index says no matter when it finished
+	void Add(uint32_t modIndex, powe::details::DirectoryTree&& fileMap)
+	{
+		{
+			std::scoped_lock lock(mutex);
+
+			InsertModFiles(modsOverwriteOrder, modIndices, modIndex, std::move(fileMap));
+			scannedModCount.fetch_add(1, std::memory_order_relaxed);
+
+			const auto now{ std::chrono::steady_clock::now() };
+			if (now - lastPublishTime < PartialPublishInterval)
+				return;
+
+			lastPublishTime = now;
+			snapshot = std::make_shared<const powe::details::ModsOverwriteOrder>(modsOverwriteOrder);
+		}
+
+		FrameScheduler::Wake();
+	}
+
+	std::shared_ptr<const powe::details::ModsOverwriteOrder> GetSnapshot() const
+	{
+		std::scoped_lock lock(mutex);
+		return snapshot;
+	}
+
+	mutable std::mutex mutex;
+	powe::details::ModsOverwriteOrder modsOverwriteOrder;
+	ModIndices modIndices;
+
+	// Once the scan is done the result moves out, these keep describing it for the watcher's updates
+	std::unordered_map<std::string, uint32_t> modPathIndices;
+	std::shared_ptr<const powe::details::ModsOverwriteOrder> snapshot;
+	std::chrono::steady_clock::time_point lastPublishTime{};
+
+	std::atomic<uint32_t> scannedModCount{};
+	std::atomic<uint32_t> modCount{};
+	std::atomic<uint32_t> changedModCount{}; // since the last scan
+};
+
 ContentManager::ContentManager(const CVarReader& cVarReader)
 	: m_ModsFilePath(cVarReader.ReadCVar("-mods"))
 	, m_InterestedExtension(cVarReader.ReadCVar("-ext"))
@@ -16,19 +137,44 @@ ContentManager::ContentManager(const CVarReader& cVarReader)
 	{
 		throw std::runtime_error("Error: -mods, -ext are required arguments");
 	}
+
+	m_WatchEnabled = cVarReader.HasCVar("-watch") && cVarReader.ReadCVar("-watch") == "on";
+
+	m_ModFingerprints = std::make_shared<ModFingerprints>(ModFingerprintsFilePath);
+	m_ModFingerprints->Load();
 }
 
 
 void ContentManager::LoadModsContentAsync()
 {
+	m_ScanState = std::make_shared<ScanState>();
+
+	// the scan sees everything up to now, what the watcher found before it is stale
+	{
+		std::scoped_lock lock(m_ModUpdatesMutex);
+		m_ModUpdates.clear();
+		m_LostModUpdates = false;
+	}
+
+	if (m_WatchEnabled && (!m_ModsWatcher || !m_ModsWatcher->IsWatching()))
+	{
+		m_ModsWatcher.reset();
+		m_ModsWatcher = std::make_unique<FolderWatcher>(m_ModsFilePath,
+			[this](std::vector<FolderWatcher::Change>&& changes) { OnModsFolderChanged(std::move(changes)); });
+	}
+
 	auto loadModsContent = [
 		modsPath = std::string_view(m_ModsFilePath),
-			extension = std::string_view(m_InterestedExtension)]() -> powe::details::ModsOverwriteOrder
+			extension = std::string_view(m_InterestedExtension),
+			scanState = m_ScanState,
+			fingerprints = m_ModFingerprints]() -> powe::details::ModsOverwriteOrder
 		{
-			powe::details::ModsOverwriteOrder modsOverwriteOrder;
-			std::vector<std::future<powe::details::DirectoryTree>> searchFutures;
+			const Tracer::Scope traceScope{ "scan mods", modsPath };
+
+			std::vector<std::future<void>> searchFutures;
 
-			const uint32_t threadCount{ ThreadPool::Size() };
+			// A search waits on its own tasks in the pool, so no more than half of the pool searches at once
+			const uint32_t maxSearchCount{ std::max(1u, ThreadPool::Size() / 2) };
 
 
 			for (const auto& entry : fs::directory_iterator(modsPath, fs::directory_options::skip_permission_denied))
@@ -36,45 +182,66 @@ void ContentManager::LoadModsContentAsync()
 				// for every directory, we'll initiate an async call
 				if (entry.is_directory())
 				{
-					//searchFutures.emplace_back(std::async(RecursiveFileSearch, entry.path().string(), extension));
-
-					// Pretty much we wait until some of the works gets finished so we don't occupy all the threads
-					if (searchFutures.size() > threadCount / 2)
-					{
-						for (auto& contentFuture : searchFutures)
-						{
-							auto fileMap = contentFuture.get();
-							for (const auto& [fileName, path] : fileMap)
-							{
-								modsOverwriteOrder[fileName].emplace_back(path);
-							}
-						}
+					const uint32_t modIndex{ scanState->AddModPath(entry.path().string()) };
 
-						searchFutures.clear();
-					}
+					// how many mods get walked at once is up to how fast the mods disk keeps up
+					auto permit{ std::make_shared<IOThrottle::Permit>(
+						IOThrottle::Acquire(IODevice::Mods, IOStage::Scan, 0, {}, maxSearchCount)) };
 
+					// every mod goes into the result as soon as it's done, a big one doesn't hold up the rest
 					searchFutures.emplace_back(
 						ThreadPool::Enqueue(
-							RecursiveFileSearch,
+							[permit, scanState, fingerprints, modIndex](const std::string& modPath, std::string_view extension) mutable
+							{
+								// the future keeps the task and what it captured until get, which only comes after every
+								// mod got its permit. Out of the capture it's given back when the walk ends
+								const auto taskPermit{ std::move(permit) };
+
+								// the walk that fingerprints the mod finds its archives too
+								auto fingerprint{ ModFingerprints::Create(modPath, extension) };
+								taskPermit->SetAmount(fingerprint.fileMap.size());
+
+								if (!fingerprints->Update(modPath, std::move(fingerprint.root)).empty())
+									scanState->changedModCount.fetch_add(1, std::memory_order_relaxed);
+
+								scanState->Add(modIndex, std::move(fingerprint.fileMap));
+							},
 							entry.path().string(), extension));
 				}
 			}
 
 			for (auto& future : searchFutures)
 			{
-				auto fileMap = future.get();
-				for (const auto& [fileName, path] : fileMap)
+				future.get();
+			}
+
+			// the last mods can come in right after a snapshot, the partial result ends up complete either way
+			std::vector<std::string> modPaths{};
+			{
+				std::scoped_lock lock(scanState->mutex);
+				scanState->snapshot = std::make_shared<const powe::details::ModsOverwriteOrder>(scanState->modsOverwriteOrder);
+
+				for (const auto& [modPath, modIndex] : scanState->modPathIndices)
 				{
-					modsOverwriteOrder[fileName].emplace_back(path);
+					modPaths.emplace_back(modPath);
 				}
 			}
 
+			// mods that were deleted while the program wasn't running
+			fingerprints->Prune(modPaths);
+			fingerprints->Save();
 
+			Logger::Info(scanState->changedModCount.load(std::memory_order_relaxed), " of ", modPaths.size(),
+				" mods changed since the last scan, ", fingerprints->GetChangedArchives().size(), " archives to rebuild");
 
-			return modsOverwriteOrder;
+			// nothing else touches it once every search is done
+			std::scoped_lock lock(scanState->mutex);
+			return std::move(scanState->modsOverwriteOrder);
 		};
 
-		m_LoadModsContentFuture = std::async(std::launch::async, loadModsContent);
+		auto task{ FrameScheduler::Async(loadModsContent) };
+		m_LoadModsContentFuture = std::move(task.result);
+		m_LoadModsContentThread = std::move(task.thread);
 		//m_LoadModsContentFuture = ThreadPool::Enqueue(loadModsContent);
 }
 
@@ -95,3 +262,168 @@ bool ContentManager::IsFinished()
 	return !m_ModsOverwriteOrder.empty();
 }
 
+std::shared_ptr<const powe::details::ModsOverwriteOrder> ContentManager::GetPartialModsOverwriteOrder() const
+{
+	return m_ScanState ? m_ScanState->GetSnapshot() : nullptr;
+}
+
+ContentManager::ScanProgress ContentManager::GetScanProgress() const
+{
+	if (!m_ScanState)
+		return {};
+
+	return ScanProgress{
+		m_ScanState->scannedModCount.load(std::memory_order_relaxed),
+		m_ScanState->modCount.load(std::memory_order_relaxed) };
+}
+
+bool ContentManager::ApplyWatchedChanges()
+{
+	// a scan that's still running picks the changes up itself, the updates wait until it's done
+	if (!m_ScanState || m_LoadModsContentFuture.valid())
+		return false;
+
+	std::vector<ModUpdate> modUpdates{};
+	bool lostModUpdates{};
+	{
+		std::scoped_lock lock(m_ModUpdatesMutex);
+		modUpdates.swap(m_ModUpdates);
+		std::swap(lostModUpdates, m_LostModUpdates);
+	}
+
+	if (modUpdates.empty() && !lostModUpdates)
+		return false;
+
+	auto& scanState{ *m_ScanState };
+	std::scoped_lock lock(scanState.mutex);
+
+	if (lostModUpdates)
+	{
+		for (const auto& [modPath, modIndex] : scanState.modPathIndices)
+		{
+			std::error_code error{};
+			if (!fs::is_directory(modPath, error))
+			{
+				m_ModFingerprints->Remove(modPath);
+				modUpdates.push_back({ modPath, {}, true });
+			}
+		}
+	}
+
+	for (auto& modUpdate : modUpdates)
+	{
+		const auto indexItr{ scanState.modPathIndices.find(modUpdate.modPath) };
+		if (indexItr != scanState.modPathIndices.end())
+		{
+			EraseModFiles(m_ModsOverwriteOrder, scanState.modIndices, indexItr->second);
+
+			if (modUpdate.removed)
+			{
+				Logger::Info("Mod removed: ", fs::path(modUpdate.modPath).filename());
+				scanState.modPathIndices.erase(indexItr);
+				continue;
+			}
+		}
+		else if (modUpdate.removed)
+		{
+			continue;
+		}
+
+		// a new mod goes last and wins over the others until the next Refresh puts it in folder order
+		uint32_t modIndex{};
+		if (indexItr != scanState.modPathIndices.end())
+		{
+			modIndex = indexItr->second;
+		}
+		else
+		{
+			modIndex = scanState.modCount.fetch_add(1, std::memory_order_relaxed);
+			scanState.modPathIndices.emplace(modUpdate.modPath, modIndex);
+			scanState.scannedModCount.fetch_add(1, std::memory_order_relaxed);
+			Logger::Info("Mod added: ", fs::path(modUpdate.modPath).filename());
+		}
+
+		InsertModFiles(m_ModsOverwriteOrder, scanState.modIndices, modIndex, std::move(modUpdate.fileMap));
+	}
+
+	return true;
+}
+
+void ContentManager::OnModsFolderChanged(std::vector<FolderWatcher::Change>&& changes)
+{
+	const fs::path modsPath{ m_ModsFilePath };
+
+	// only whole mods are searched again, whatever changed inside one
+	std::vector<std::string> modPaths{};
+	bool lostModUpdates{};
+
+	for (const auto& change : changes)
+	{
+		const fs::path relativePath{ change.path.lexically_relative(modsPath) };
+		if (relativePath.empty() || relativePath == ".")
+		{
+			lostModUpdates = true;
+			continue;
+		}
+
+		// built the same way as the scan does so the paths match
+		modPaths.emplace_back((modsPath / *relativePath.begin()).string());
+	}
+
+	if (lostModUpdates)
+	{
+		modPaths.clear();
+
+		std::error_code error{};
+		for (const auto& entry : fs::directory_iterator(m_ModsFilePath, fs::directory_options::skip_permission_denied, error))
+		{
+			if (entry.is_directory(error))
+				modPaths.emplace_back(entry.path().string());
+		}
+	}
+
+	std::sort(modPaths.begin(), modPaths.end());
+	modPaths.erase(std::unique(modPaths.begin(), modPaths.end()), modPaths.end());
+
+	std::vector<ModUpdate> modUpdates{};
+	for (auto& modPath : modPaths)
+	{
+		std::error_code error{};
+		if (!fs::is_directory(modPath, error))
+		{
+			m_ModFingerprints->Remove(modPath);
+			modUpdates.push_back({ std::move(modPath), {}, true });
+			continue;
+		}
+
+		// a folder that's removed while it's walked just comes out empty, the next batch has the Removed for it
+		auto fingerprint{ ModFingerprints::Create(modPath, m_InterestedExtension) };
+		m_ModFingerprints->Update(modPath, std::move(fingerprint.root));
+		modUpdates.push_back({ std::move(modPath), std::move(fingerprint.fileMap), false });
+	}
+
+	m_ModFingerprints->Save();
+
+	{
+		std::scoped_lock lock(m_ModUpdatesMutex);
+		std::move(modUpdates.begin(), modUpdates.end(), std::back_inserter(m_ModUpdates));
+		m_LostModUpdates = m_LostModUpdates || lostModUpdates;
+	}
+
+	FrameScheduler::Wake();
+}
+
+std::unordered_set<std::string> ContentManager::GetChangedArchives() const
+{
+	return m_ModFingerprints->GetChangedArchives();
+}
+
+void ContentManager::SetArchivesMerged(const std::unordered_set<std::string>& archiveNames)
+{
+	m_ModFingerprints->RemoveChangedArchives(archiveNames);
+
+	LowFrequencyThreadPool::EnqueueDetach([fingerprints = m_ModFingerprints]()
+		{
+			fingerprints->Save();
+		});
+}
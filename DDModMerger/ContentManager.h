@@ -1,8 +1,13 @@
 #pragma once
 
 #include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 #include "CVarReader.h"
 #include "Types.h"
+#include "FolderWatcher.h"
+#include "ModFingerprints.h"
 
 class ContentManager
 {
@@ -17,12 +22,59 @@ public:
 	bool IsFinished();
 	std::string_view GetModsFilePath() const { return m_ModsFilePath; }
 
+	// What's been scanned so far, the mods of every file in the same order as the finished result.
+	// A new snapshot every so often while the scan runs, nullptr until the first one
+	std::shared_ptr<const powe::details::ModsOverwriteOrder> GetPartialModsOverwriteOrder() const;
+
+	struct ScanProgress
+	{
+		uint32_t scannedModCount{};
+		uint32_t modCount{}; // only final once every mod folder is queued
+	};
+
+	ScanProgress GetScanProgress() const;
+
+	// With -watch on, mods that are added, removed or changed after the scan go in without another one.
+	// Only call it on the UI thread. True when the overwrite order changed
+	bool ApplyWatchedChanges();
+
+	// Archives whose mods changed since they were last merged, their output needs rebuilding
+	std::unordered_set<std::string> GetChangedArchives() const;
+
+	// A merge of these went through, what changed while it ran stays
+	void SetArchivesMerged(const std::unordered_set<std::string>& archiveNames);
+
 private:
 
+	// Runs on the watcher's thread, searches the mods that changed and queues the result for the UI
+	void OnModsFolderChanged(std::vector<FolderWatcher::Change>&& changes);
+
+	struct ModUpdate
+	{
+		std::string modPath;
+		powe::details::DirectoryTree fileMap;
+		bool removed{};
+	};
+
+	// shared with the search tasks, a new one for every load
+	struct ScanState;
+	std::shared_ptr<ScanState> m_ScanState;
 
 	powe::details::ModsOverwriteOrder m_ModsOverwriteOrder;
 	std::future<powe::details::ModsOverwriteOrder> m_LoadModsContentFuture;
+	std::future<void> m_LoadModsContentThread; // after the future, it's joined before the future goes
 
 	std::string m_ModsFilePath;
 	std::string m_InterestedExtension;
+
+	// shared with the scan and the watcher
+	std::shared_ptr<ModFingerprints> m_ModFingerprints;
+
+	bool m_WatchEnabled{};
+	std::mutex m_ModUpdatesMutex;
+	std::vector<ModUpdate> m_ModUpdates;
+	bool m_LostModUpdates{}; // the watcher missed events, mods that are gone have to be found by looking
+
+	// last, its callback uses everything above
+	std::unique_ptr<FolderWatcher> m_ModsWatcher;
 };
\ No newline at end of file
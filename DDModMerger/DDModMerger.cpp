@@ -4,6 +4,7 @@
 #include <iostream>
 #include <any>
 #include <variant>
+#include <chrono>
 
 #include "DirTreeCreator.h"
 #include "ModMerger.h"
@@ -15,6 +16,13 @@
 #include "MergeArea.h"
 #include "FileCloneUtility.h"
 #include "LowFrequencyThreadPool.h"
+#include "ConflictAnalyzer.h"
+#include "CodecBenchmark.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "LogPanel.h"
+#include "DiagnosticsPanel.h"
+#include "FrameScheduler.h"
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
@@ -58,6 +66,22 @@ int main(int argc, char* argv[])
 	if (!cvReader.CheckArgs())
 		return -1;
 
+	// -benchmark <arc file or folder> runs the entry codec benchmark without opening a window
+	if (cvReader.HasCVar("-benchmark"))
+	{
+		RunCodecBenchmark(cvReader.ReadCVar("-benchmark"));
+		return 0;
+	}
+
+	// -log <file> and -log-level <debug|info|warning|error>, the console always gets the same lines
+	Logger::Init(
+		cvReader.HasCVar("-log") ? cvReader.ReadCVar("-log") : "./DDModMerger.log",
+		cvReader.HasCVar("-log-level") ? ParseLogLevel(cvReader.ReadCVar("-log-level")) : LogLevel::Info);
+
+	// -trace <file> records every merge stage, ModMerger writes the file after each merge
+	if (cvReader.HasCVar("-trace"))
+		Tracer::SetEnabled(true);
+
 	// Setup window
 	glfwSetErrorCallback(glfw_error_callback);
 	if (!glfwInit())
@@ -91,26 +115,56 @@ int main(int argc, char* argv[])
 	ImGui_ImplOpenGL3_Init(glslVersion.c_str()); // Pass your OpenGL version here
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
+	// Background tasks wake the loop up when they change something, glfwPostEmptyEvent is safe from any thread
+	FrameScheduler::SetWakeHandler([]() { glfwPostEmptyEvent(); });
+
 	// Initialize DDModManager Global Context Variables
 
 	ThreadPool::Init(std::thread::hardware_concurrency());
 	LowFrequencyThreadPool::Init(std::thread::hardware_concurrency() / 2);
 
+	// -watch on follows the mods and game folders after the first Refresh, what changes shows up without another one
 	std::shared_ptr<ContentManager> contentManager{ std::make_shared<ContentManager>(cvReader) };
 	std::shared_ptr<DirTreeCreator> dirTreeCreator{ std::make_shared<DirTreeCreator>(cvReader) };
 	std::shared_ptr<FileCloneUtility> cloneUtility{ std::make_shared<FileCloneUtility>(cvReader) };
 	std::shared_ptr<ModMerger> modMerger{ std::make_shared<ModMerger>(cvReader) };
+	std::shared_ptr<ConflictAnalyzer> conflictAnalyzer{ std::make_shared<ConflictAnalyzer>() };
 
 	// Initialize Widgets
-	std::shared_ptr<MergeArea> mergeArea{ std::make_shared<MergeArea>(contentManager,dirTreeCreator,modMerger) };
+	std::shared_ptr<MergeArea> mergeArea{ std::make_shared<MergeArea>(contentManager,dirTreeCreator,modMerger,conflictAnalyzer) };
 	std::shared_ptr<MenuBar> menuBar{ std::make_shared<MenuBar>(
 		std::make_unique<RefreshTask>(contentManager,mergeArea,dirTreeCreator),
-		std::make_unique<MergeTask>(modMerger,mergeArea,dirTreeCreator,cloneUtility,cvReader.ReadCVar("-arctool"))) };
+		std::make_unique<MergeTask>(modMerger,mergeArea,dirTreeCreator,cloneUtility,cvReader.ReadCVar("-arctool")),
+		std::make_unique<RestoreBackupTask>(cloneUtility)) };
+	std::shared_ptr<LogPanel> logPanel{ std::make_shared<LogPanel>() };
+	std::shared_ptr<DiagnosticsPanel> diagnosticsPanel{ std::make_shared<DiagnosticsPanel>() };
+
 
+	// Nothing gets drawn while nothing changes. ImGui needs a frame or two after input
+	// to settle hovers, popups and clicks, so a few frames are drawn after every wake up
+	constexpr double IdleTimeout{ 1.0 };
+	constexpr int FramesAfterWake{ 2 };
+	int framesToDraw{ FramesAfterWake };
+	double waitTimeout{};
 
 	while (!glfwWindowShouldClose(window))
 	{
-		glfwPollEvents();
+		if (framesToDraw > 0)
+		{
+			glfwPollEvents();
+			framesToDraw--;
+		}
+		else
+		{
+			const double waitStartTime{ glfwGetTime() };
+			glfwWaitEventsTimeout(waitTimeout);
+
+			// back before the timeout means input or a background task
+			if (glfwGetTime() - waitStartTime < waitTimeout)
+				framesToDraw = FramesAfterWake;
+		}
+
+		const auto frameStartTime{ std::chrono::steady_clock::now() };
 
 		// Start the Dear ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
@@ -125,7 +179,7 @@ int main(int argc, char* argv[])
 
 		ImGui::Dummy(ImVec2(0.0f, 10.0f));
 		ImGui::PushStyleVar(ImGuiStyleVar_ChildRounding, 5.0f);
-		if (ImGui::BeginChild("ChildR", ImVec2(-1.0f, -1.0f), ImGuiChildFlags_Border))
+		if (ImGui::BeginChild("ChildR", ImVec2(-1.0f, -(logPanel->GetReservedHeight() + diagnosticsPanel->GetReservedHeight())), ImGuiChildFlags_Border))
 		{
 			ImGui::PopStyleVar();
 
@@ -134,6 +188,9 @@ int main(int argc, char* argv[])
 			ImGui::EndChild();
 		}
 
+		diagnosticsPanel->Draw();
+		logPanel->Draw();
+
 
 		ImGui::End();
 
@@ -146,10 +203,20 @@ int main(int argc, char* argv[])
 		glClear(GL_COLOR_BUFFER_BIT);
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+		diagnosticsPanel->AddFrameTime(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStartTime).count());
+
+		// the text cursor blinks
+		if (io.WantTextInput)
+			FrameScheduler::RequestFrameWithin(0.5);
+
+		waitTimeout = FrameScheduler::TakeWaitTimeout(IdleTimeout);
+
 		glfwSwapBuffers(window);
 	}
 
 	// Exiting
+	FrameScheduler::SetWakeHandler(nullptr);
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -157,6 +224,8 @@ int main(int argc, char* argv[])
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
+	Logger::Shutdown();
+
 	return 0;
 }
 
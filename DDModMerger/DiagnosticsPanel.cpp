@@ -0,0 +1,183 @@
+#include "DiagnosticsPanel.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "ThreadPool.h"
+#include "LowFrequencyThreadPool.h"
+#include "IOThrottle.h"
+#include "FrameScheduler.h"
+
+constexpr int PoolRowCount{ 2 };
+
+void DiagnosticsPanel::Draw()
+{
+	m_Open = ImGui::CollapsingHeader("Diagnostics");
+	if (!m_Open)
+		return;
+
+	// the counters move on their own, a few frames a second is plenty to read them
+	FrameScheduler::RequestFrameWithin(0.25);
+
+	{
+		const size_t frameCount{ std::min(m_FrameCount, FrameTimeCount) };
+		const auto frameTimesEnd{ m_FrameTimes.begin() + frameCount };
+		const float averageFrameTime{ frameCount > 0 ? std::accumulate(m_FrameTimes.begin(), frameTimesEnd, 0.0f) / float(frameCount) : 0.0f };
+		const float maxFrameTime{ frameCount > 0 ? *std::max_element(m_FrameTimes.begin(), frameTimesEnd) : 0.0f };
+
+		ImGui::Text("UI frame %.2f ms avg, %.2f ms max (last %d frames)", averageFrameTime, maxFrameTime, int(frameCount));
+	}
+
+	if (ImGui::SmallButton("Reset latencies"))
+	{
+		ThreadPool::ResetLatencies();
+		LowFrequencyThreadPool::ResetLatencies();
+	}
+
+	ImGui::SameLine();
+	ImGui::TextDisabled("Blocked = running but waiting on another task");
+
+	if (ImGui::BeginTable("PoolMetrics", 10, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+	{
+		ImGui::TableSetupColumn("Pool");
+		ImGui::TableSetupColumn("Workers");
+		ImGui::TableSetupColumn("Queued");
+		ImGui::TableSetupColumn("Active");
+		ImGui::TableSetupColumn("Blocked");
+		ImGui::TableSetupColumn("Completed");
+		ImGui::TableSetupColumn("Wait mean");
+		ImGui::TableSetupColumn("Wait p99");
+		ImGui::TableSetupColumn("Run mean");
+		ImGui::TableSetupColumn("Run p99");
+		ImGui::TableHeadersRow();
+
+		DrawPoolRow("Main", ThreadPool::GetMetrics());
+		DrawPoolRow("Low frequency", LowFrequencyThreadPool::GetMetrics());
+
+		ImGui::EndTable();
+	}
+
+	DrawIOTable();
+}
+
+float DiagnosticsPanel::GetReservedHeight() const
+{
+	float height{ ImGui::GetFrameHeightWithSpacing() };
+	if (m_Open)
+	{
+		height += ImGui::GetTextLineHeightWithSpacing() + ImGui::GetFrameHeightWithSpacing() * (PoolRowCount + 2);
+
+		if (m_IORowCount > 0)
+			height += ImGui::GetFrameHeightWithSpacing() * (m_IORowCount + 1);
+	}
+
+	return height;
+}
+
+void DiagnosticsPanel::AddFrameTime(float frameTime)
+{
+	m_FrameTimes[m_FrameCount % FrameTimeCount] = frameTime;
+	m_FrameCount++;
+}
+
+void DiagnosticsPanel::DrawPoolRow(const char* poolName, const ThreadPoolMetrics::Snapshot& snapshot) const
+{
+	ImGui::TableNextRow();
+
+	ImGui::TableNextColumn();
+	ImGui::TextUnformatted(poolName);
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%u", snapshot.workerCount);
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", static_cast<unsigned long long>(snapshot.queueDepth));
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", static_cast<unsigned long long>(snapshot.activeCount));
+
+	ImGui::TableNextColumn();
+	if (snapshot.blockedCount > 0)
+		ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), "%llu", static_cast<unsigned long long>(snapshot.blockedCount));
+	else
+		ImGui::Text("0");
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%llu", static_cast<unsigned long long>(snapshot.completedCount));
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f ms", snapshot.meanWaitTime);
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f ms", snapshot.p99WaitTime);
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f ms", snapshot.meanRunTime);
+
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f ms", snapshot.p99RunTime);
+}
+
+void DiagnosticsPanel::DrawIOTable()
+{
+	// only what has seen any I/O so far
+	m_IORowCount = 0;
+	for (size_t device = 0; device < size_t(IODevice::Count); device++)
+	{
+		for (size_t stage = 0; stage < size_t(IOStage::Count); stage++)
+		{
+			const auto stats{ IOThrottle::GetStats(IODevice(device), IOStage(stage)) };
+			if (stats.completedCount > 0 || stats.inFlight > 0)
+				m_IORowCount++;
+		}
+	}
+
+	if (m_IORowCount == 0)
+		return;
+
+	if (ImGui::BeginTable("IOMetrics", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+	{
+		ImGui::TableSetupColumn("Device");
+		ImGui::TableSetupColumn("Stage");
+		ImGui::TableSetupColumn("Limit");
+		ImGui::TableSetupColumn("In flight");
+		ImGui::TableSetupColumn("Throughput");
+		ImGui::TableHeadersRow();
+
+		for (size_t device = 0; device < size_t(IODevice::Count); device++)
+		{
+			for (size_t stage = 0; stage < size_t(IOStage::Count); stage++)
+			{
+				const auto stats{ IOThrottle::GetStats(IODevice(device), IOStage(stage)) };
+				if (stats.completedCount == 0 && stats.inFlight == 0)
+					continue;
+
+				const std::string_view deviceName{ GetIODeviceName(IODevice(device)) };
+
+				ImGui::TableNextRow();
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(deviceName.data(), deviceName.data() + deviceName.size());
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(IOStage(stage) == IOStage::Scan ? "Scan" : "Transfer");
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", stats.limit);
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", stats.inFlight);
+
+				ImGui::TableNextColumn();
+				if (IOStage(stage) == IOStage::Scan)
+					ImGui::Text("%.0f files/s", stats.throughput);
+				else
+					ImGui::Text("%.1f MB/s", stats.throughput / double(1 << 20));
+			}
+		}
+
+		ImGui::EndTable();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Widget.h"
+
+#include "ThreadPoolMetrics.h"
+
+#include <array>
+
+/// <summary>
+/// Live counters of both thread pools and the I/O limit of every disk, so a slow merge can be told apart
+/// between not enough threads, threads waiting on each other, a slow disk and plain slow work
+/// </summary>
+class DiagnosticsPanel : public Widget
+{
+public:
+
+	DiagnosticsPanel() = default;
+
+	void Draw() override;
+	~DiagnosticsPanel() = default;
+
+	// Room the panel takes under the merge area, open or not
+	float GetReservedHeight() const;
+
+	// CPU time of one UI frame in milliseconds, the wait for the swap not included
+	void AddFrameTime(float frameTime);
+
+private:
+
+	void DrawPoolRow(const char* poolName, const ThreadPoolMetrics::Snapshot& snapshot) const;
+	void DrawIOTable();
+
+	static constexpr size_t FrameTimeCount{ 120 };
+	std::array<float, FrameTimeCount> m_FrameTimes{};
+	size_t m_FrameCount{};
+
+	int m_IORowCount{};
+	bool m_Open{};
+};
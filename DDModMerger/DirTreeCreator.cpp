@@ -1,12 +1,18 @@
 #include "DirTreeCreator.h"
 
-#include <iostream>
 
 #include "Types.h"
 #include "nlohmann/json.hpp"
 #include "EnvironmentVariables.h"
 #include "utils.h"
 #include "ThreadPool.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "FrameScheduler.h"
+#include "LowFrequencyThreadPool.h"
+
+#include <algorithm>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
@@ -24,7 +30,7 @@ std::unordered_map<std::string, std::string> ReadJSONFile(const std::string& fil
 
 	// Check if the file is open
 	if (!fileStream.is_open()) {
-		std::cerr << "Error: Failed to open file: " << filePath << std::endl;
+		Logger::Error("Failed to open file: ", filePath);
 		return fileMap;
 	};
 
@@ -43,13 +49,32 @@ std::unordered_map<std::string, std::string> ReadJSONFile(const std::string& fil
 	}
 	catch (const std::exception& e)
 	{
-		std::cerr << "Error: " << e.what() << '\n';
+		Logger::Error(e.what());
 	}
 
 
 	return fileMap;
 }
 
+bool WriteJSONFile(const fs::path& filePath, const powe::details::DirectoryTree& fileMap)
+{
+	fs::create_directories(filePath.parent_path());
+	std::ofstream outputFile(filePath);
+
+	try
+	{
+		nlohmann::json jsonWriter = fileMap;
+		outputFile << jsonWriter.dump(4);
+	}
+	catch (const std::exception&)
+	{
+		Logger::Error("Failed to write to file: ", filePath);
+		return false;
+	}
+
+	return true;
+}
+
 
 DirTreeCreator::DirTreeCreator(const CVarReader& cVarReader)
 {
@@ -67,6 +92,8 @@ DirTreeCreator::DirTreeCreator(const CVarReader& cVarReader)
 	if (m_SearchFolderPath.empty() || m_InterestedExtension.empty() || m_OutputFilePath.empty()) {
 		throw std::runtime_error("Error: -path, -ext, -out are required arguments");
 	}
+
+	m_WatchEnabled = cVarReader.HasCVar("-watch") && cVarReader.ReadCVar("-watch") == "on";
 }
 
 powe::details::DirectoryTree DirTreeCreator::CreateDirTree(bool measureTime) const
@@ -79,7 +106,8 @@ powe::details::DirectoryTree DirTreeCreator::CreateDirTree(bool measureTime) con
 		fileMap = CreateDirTreeIntern();
 		auto end = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> elapsed = end - start;
-		std::cout << "Create DirTree elapsed time: " << elapsed.count() << "s\n";
+		Logger::Info("Create DirTree elapsed time: ", elapsed.count(), "s");
+		return fileMap;
 	}
 
 	return CreateDirTreeIntern();
@@ -87,6 +115,19 @@ powe::details::DirectoryTree DirTreeCreator::CreateDirTree(bool measureTime) con
 
 void DirTreeCreator::CreateDirTreeAsync(bool measureTime)
 {
+	// the scan sees everything up to now, what the watcher found before it is stale
+	{
+		std::scoped_lock lock(m_DirTreeUpdatesMutex);
+		m_DirTreeUpdates.clear();
+	}
+
+	if (m_WatchEnabled && (!m_GameFolderWatcher || !m_GameFolderWatcher->IsWatching()))
+	{
+		m_GameFolderWatcher.reset();
+		m_GameFolderWatcher = std::make_unique<FolderWatcher>(fs::path(m_SearchFolderPath) / DEFAULT_DD_TOPLEVEL_FOLDER,
+			[this](std::vector<FolderWatcher::Change>&& changes) { OnGameFolderChanged(std::move(changes)); });
+	}
+
 	if (measureTime)
 	{
 		auto createDirTree = [this]() -> powe::details::DirectoryTree
@@ -96,11 +137,13 @@ void DirTreeCreator::CreateDirTreeAsync(bool measureTime)
 				fileMap = CreateDirTreeIntern();
 				auto end = std::chrono::high_resolution_clock::now();
 				std::chrono::duration<double> elapsed = end - start;
-				std::cout << "Create DirTree elapsed time: " << elapsed.count() << "s\n";
+				Logger::Info("Create DirTree elapsed time: ", elapsed.count(), "s");
 				return fileMap;
 			};
 
-		m_CreateDirTreeFuture = std::async(std::launch::async, createDirTree);
+		auto task{ FrameScheduler::Async(createDirTree) };
+		m_CreateDirTreeFuture = std::move(task.result);
+		m_CreateDirTreeThread = std::move(task.thread);
 	}
 	else
 	{
@@ -109,7 +152,9 @@ void DirTreeCreator::CreateDirTreeAsync(bool measureTime)
 				return CreateDirTreeIntern();
 			};
 
-		m_CreateDirTreeFuture = std::async(std::launch::async, createDirTree);
+		auto task{ FrameScheduler::Async(createDirTree) };
+		m_CreateDirTreeFuture = std::move(task.result);
+		m_CreateDirTreeThread = std::move(task.thread);
 	}
 
 }
@@ -132,6 +177,8 @@ bool DirTreeCreator::IsFinished()
 
 powe::details::DirectoryTree DirTreeCreator::CreateDirTreeIntern() const
 {
+	const Tracer::Scope traceScope{ "scan game", m_SearchFolderPath };
+
 	fs::path outputPath{ DirTreeFolder };
 	outputPath /= DirTreeJSONFileName;
 
@@ -143,7 +190,7 @@ powe::details::DirectoryTree DirTreeCreator::CreateDirTreeIntern() const
 
 		if (tempFileMap.empty())
 		{
-			std::cerr << "Error: Failed to read file: " << outputPath << std::endl;
+			Logger::Error("Failed to read file: ", outputPath);
 		}
 
 		return tempFileMap;
@@ -154,21 +201,124 @@ powe::details::DirectoryTree DirTreeCreator::CreateDirTreeIntern() const
 
 	auto outFileMap{ RecursiveFileSearch(searchFolder.string() , m_InterestedExtension) };
 
-	fs::create_directories(outputPath.parent_path());
-	std::ofstream outputFile(outputPath);
+	if (!WriteJSONFile(outputPath, outFileMap))
+		return outFileMap;
+
+	Logger::Info("Search completed. Results are saved in: ", outputPath);
+
+	return outFileMap;
+}
+
+bool DirTreeCreator::ApplyWatchedChanges()
+{
+	// a scan that's still running picks the changes up itself, the updates wait until it's done
+	if (m_CreateDirTreeFuture.valid() || m_DirTree.empty())
+		return false;
+
+	std::vector<DirTreeUpdate> dirTreeUpdates{};
+	{
+		std::scoped_lock lock(m_DirTreeUpdatesMutex);
+		dirTreeUpdates.swap(m_DirTreeUpdates);
+	}
+
+	if (dirTreeUpdates.empty())
+		return false;
+
+	for (auto& dirTreeUpdate : dirTreeUpdates)
+	{
+		if (dirTreeUpdate.replace)
+		{
+			m_DirTree = std::move(dirTreeUpdate.addedFiles);
+			continue;
+		}
+
+		if (!dirTreeUpdate.removedPaths.empty())
+		{
+			// one pass over the tree no matter how many archives a deleted folder had
+			const std::unordered_set<std::string> removedPaths(dirTreeUpdate.removedPaths.begin(), dirTreeUpdate.removedPaths.end());
+			std::erase_if(m_DirTree, [&removedPaths](const auto& entry)
+				{
+					for (fs::path path{ entry.second }; path.has_relative_path(); path = path.parent_path())
+					{
+						if (removedPaths.contains(path.string()))
+							return true;
+					}
+
+					return false;
+				});
+		}
+
+		for (auto& [fileName, path] : dirTreeUpdate.addedFiles)
+		{
+			m_DirTree.insert_or_assign(fileName, std::move(path));
+		}
+	}
+
+	// the cache is read instead of scanning next time, it has to follow
+	LowFrequencyThreadPool::EnqueueDetach([dirTree = m_DirTree]()
+		{
+			static std::mutex writeMutex{};
+			std::scoped_lock lock(writeMutex);
+			WriteJSONFile(fs::path(DirTreeFolder) / DirTreeJSONFileName, dirTree);
+		});
+
+	return true;
+}
+
+void DirTreeCreator::OnGameFolderChanged(std::vector<FolderWatcher::Change>&& changes)
+{
+	const fs::path rootPath{ fs::path(m_SearchFolderPath) / DEFAULT_DD_TOPLEVEL_FOLDER };
+
+	DirTreeUpdate dirTreeUpdate{};
 
 	try
 	{
-		nlohmann::json jsonWriter = outFileMap;
-		outputFile << jsonWriter.dump(4);
+		for (const auto& change : changes)
+		{
+			if (change.path.lexically_relative(rootPath) == ".")
+			{
+				dirTreeUpdate = DirTreeUpdate{ RecursiveFileSearch(rootPath.string(), m_InterestedExtension), {}, true };
+				continue;
+			}
+
+			if (change.type == FolderWatcher::Change::Type::Removed)
+			{
+				// an archive the tree has under another path, a duplicate name, stays
+				dirTreeUpdate.removedPaths.emplace_back(change.path.string());
+
+				// and what showed up earlier in this batch is gone again
+				std::erase_if(dirTreeUpdate.addedFiles, [&change](const auto& entry)
+					{
+						const fs::path path{ entry.second };
+						return std::mismatch(change.path.begin(), change.path.end(), path.begin(), path.end()).first == change.path.end();
+					});
+				continue;
+			}
+
+			std::error_code error{};
+			if (fs::is_directory(change.path, error))
+			{
+				dirTreeUpdate.addedFiles.merge(RecursiveFileSearch(change.path.string(), m_InterestedExtension));
+			}
+			else if (change.path.extension() == m_InterestedExtension && fs::exists(change.path, error))
+			{
+				dirTreeUpdate.addedFiles.insert_or_assign(change.path.stem().string(), change.path.string());
+			}
+		}
 	}
-	catch (const std::exception&)
+	catch (const fs::filesystem_error& e)
 	{
-		std::cerr << "Error: Failed to write to file: " << outputPath << std::endl;
-		return outFileMap;
+		// removed again while it was searched, the next batch has the Removed for it
+		Logger::Debug(e.what());
 	}
 
-	std::cout << "Search completed. Results are saved in: " << outputPath << '\n';
+	if (dirTreeUpdate.addedFiles.empty() && dirTreeUpdate.removedPaths.empty() && !dirTreeUpdate.replace)
+		return;
 
-	return outFileMap;
+	{
+		std::scoped_lock lock(m_DirTreeUpdatesMutex);
+		m_DirTreeUpdates.emplace_back(std::move(dirTreeUpdate));
+	}
+
+	FrameScheduler::Wake();
 }
@@ -4,9 +4,12 @@
 #include <fstream>
 #include <unordered_map>
 #include <future>
+#include <memory>
+#include <mutex>
 
 #include "CVarReader.h"
 #include "Types.h"
+#include "FolderWatcher.h"
 
 class DirTreeCreator
 {
@@ -19,16 +22,39 @@ public:
 	const powe::details::DirectoryTree& GetDirTree();
 	bool IsFinished();
 
+	std::string_view GetSearchFolderPath() const { return m_SearchFolderPath; }
+
+	// With -watch on, archives that show up in or go away from the game folder go in without another scan.
+	// Only call it on the UI thread. True when the dir tree changed
+	bool ApplyWatchedChanges();
 
 private:
 
 	powe::details::DirectoryTree CreateDirTreeIntern() const;
+
+	// Runs on the watcher's thread, searches what was added and queues it for the UI
+	void OnGameFolderChanged(std::vector<FolderWatcher::Change>&& changes);
+
+	struct DirTreeUpdate
+	{
+		powe::details::DirectoryTree addedFiles;
+		std::vector<std::string> removedPaths; // archives or whole folders
+		bool replace{}; // events were lost, addedFiles is everything
+	};
 	
 	powe::details::DirectoryTree m_DirTree;
 	std::future<powe::details::DirectoryTree> m_CreateDirTreeFuture;
+	std::future<void> m_CreateDirTreeThread; // after the future, it's joined before the future goes
 	
 	std::string m_SearchFolderPath;
 	std::string m_InterestedExtension;
 	std::string m_OutputFilePath;
+
+	bool m_WatchEnabled{};
+	std::mutex m_DirTreeUpdatesMutex;
+	std::vector<DirTreeUpdate> m_DirTreeUpdates;
+
+	// last, its callback uses everything above
+	std::unique_ptr<FolderWatcher> m_GameFolderWatcher;
 };
 
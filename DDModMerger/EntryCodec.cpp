@@ -0,0 +1,177 @@
+#include "EntryCodec.h"
+
+#include <algorithm>
+
+#ifdef POWE_WITH_ZLIB
+#include "zlib.h"
+#endif
+
+#ifdef POWE_WITH_ZLIB_NG
+#include "zlib-ng.h"
+#endif
+
+#ifdef POWE_WITH_LIBDEFLATE
+#include "libdeflate.h"
+#endif
+
+#ifdef POWE_WITH_ZLIB
+class ZlibCodec final : public EntryCodec
+{
+public:
+
+	std::string_view GetName() const override { return "zlib"; }
+	int GetMaxLevel() const override { return Z_BEST_COMPRESSION; }
+
+	bool Compress(const char* data, size_t size, int level, std::vector<char>& outData) const override
+	{
+		uLongf compressedSize{ compressBound(uLong(size)) };
+		outData.resize(compressedSize);
+
+		const int result{ compress2(reinterpret_cast<Bytef*>(outData.data()), &compressedSize,
+			reinterpret_cast<const Bytef*>(data), uLong(size), std::clamp(level, 0, GetMaxLevel())) };
+
+		outData.resize(compressedSize);
+		return result == Z_OK;
+	}
+
+	bool Decompress(const char* data, size_t size, size_t decompressedSize, std::vector<char>& outData) const override
+	{
+		outData.resize(decompressedSize);
+		uLongf outSize{ uLongf(decompressedSize) };
+
+		const int result{ uncompress(reinterpret_cast<Bytef*>(outData.data()), &outSize,
+			reinterpret_cast<const Bytef*>(data), uLong(size)) };
+
+		return result == Z_OK && outSize == decompressedSize;
+	}
+};
+#endif
+
+#ifdef POWE_WITH_ZLIB_NG
+class ZlibNgCodec final : public EntryCodec
+{
+public:
+
+	std::string_view GetName() const override { return "zlib-ng"; }
+	int GetMaxLevel() const override { return Z_BEST_COMPRESSION; }
+
+	bool Compress(const char* data, size_t size, int level, std::vector<char>& outData) const override
+	{
+		size_t compressedSize{ zng_compressBound(size) };
+		outData.resize(compressedSize);
+
+		const int result{ zng_compress2(reinterpret_cast<uint8_t*>(outData.data()), &compressedSize,
+			reinterpret_cast<const uint8_t*>(data), size, std::clamp(level, 0, GetMaxLevel())) };
+
+		outData.resize(compressedSize);
+		return result == Z_OK;
+	}
+
+	bool Decompress(const char* data, size_t size, size_t decompressedSize, std::vector<char>& outData) const override
+	{
+		outData.resize(decompressedSize);
+		size_t outSize{ decompressedSize };
+
+		const int result{ zng_uncompress(reinterpret_cast<uint8_t*>(outData.data()), &outSize,
+			reinterpret_cast<const uint8_t*>(data), size) };
+
+		return result == Z_OK && outSize == decompressedSize;
+	}
+};
+#endif
+
+#ifdef POWE_WITH_LIBDEFLATE
+class LibdeflateCodec final : public EntryCodec
+{
+public:
+
+	std::string_view GetName() const override { return "libdeflate"; }
+	int GetMaxLevel() const override { return 12; }
+
+	bool Compress(const char* data, size_t size, int level, std::vector<char>& outData) const override
+	{
+		auto* compressor{ GetCompressor(std::clamp(level, 0, GetMaxLevel())) };
+		if (!compressor)
+			return false;
+
+		outData.resize(libdeflate_zlib_compress_bound(compressor, size));
+
+		const size_t compressedSize{ libdeflate_zlib_compress(compressor, data, size, outData.data(), outData.size()) };
+		outData.resize(compressedSize);
+		return compressedSize > 0;
+	}
+
+	bool Decompress(const char* data, size_t size, size_t decompressedSize, std::vector<char>& outData) const override
+	{
+		auto* decompressor{ GetDecompressor() };
+		if (!decompressor)
+			return false;
+
+		outData.resize(decompressedSize);
+		return libdeflate_zlib_decompress(decompressor, data, size, outData.data(), decompressedSize, nullptr) == LIBDEFLATE_SUCCESS;
+	}
+
+private:
+
+	using CompressorPtr = std::unique_ptr<libdeflate_compressor, decltype(&libdeflate_free_compressor)>;
+	using DecompressorPtr = std::unique_ptr<libdeflate_decompressor, decltype(&libdeflate_free_decompressor)>;
+
+	// libdeflate (de)compressors aren't thread safe but are expensive to allocate, keep one per thread
+	static libdeflate_compressor* GetCompressor(int level)
+	{
+		thread_local std::vector<CompressorPtr> compressors{};
+		for (int i = int(compressors.size()); i <= level; i++)
+		{
+			compressors.emplace_back(libdeflate_alloc_compressor(i), &libdeflate_free_compressor);
+		}
+
+		return compressors[level].get();
+	}
+
+	static libdeflate_decompressor* GetDecompressor()
+	{
+		thread_local DecompressorPtr decompressor{ libdeflate_alloc_decompressor(), &libdeflate_free_decompressor };
+		return decompressor.get();
+	}
+};
+#endif
+
+std::shared_ptr<EntryCodec> EntryCodec::Create([[maybe_unused]] std::string_view name)
+{
+	// prefer the fastest backend when nothing is asked for
+#ifdef POWE_WITH_LIBDEFLATE
+	if (name.empty() || name == "libdeflate")
+		return std::make_shared<LibdeflateCodec>();
+#endif
+
+#ifdef POWE_WITH_ZLIB_NG
+	if (name.empty() || name == "zlib-ng")
+		return std::make_shared<ZlibNgCodec>();
+#endif
+
+#ifdef POWE_WITH_ZLIB
+	if (name.empty() || name == "zlib")
+		return std::make_shared<ZlibCodec>();
+#endif
+
+	return nullptr;
+}
+
+std::vector<std::string_view> EntryCodec::GetAvailableCodecs()
+{
+	std::vector<std::string_view> codecs{};
+
+#ifdef POWE_WITH_LIBDEFLATE
+	codecs.emplace_back("libdeflate");
+#endif
+
+#ifdef POWE_WITH_ZLIB_NG
+	codecs.emplace_back("zlib-ng");
+#endif
+
+#ifdef POWE_WITH_ZLIB
+	codecs.emplace_back("zlib");
+#endif
+
+	return codecs;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Backends are picked at build time, define any of these with the matching library linked:
+// POWE_WITH_ZLIB (zlib.h), POWE_WITH_ZLIB_NG (zlib-ng.h native API), POWE_WITH_LIBDEFLATE (libdeflate.h)
+// The Visual Studio project defines POWE_WITH_ZLIB and compiles zlib from Setup.bat's download.
+// Without any of them the merge keeps unpacking and repacking through ARCTool.
+
+/// <summary>
+/// Deflate backend for ARC entries. Entries are zlib streams (header + adler32)
+/// so every backend has to produce and read that exact format.
+/// Implementations must be safe to call from many threads at once
+/// </summary>
+class EntryCodec
+{
+public:
+
+	virtual ~EntryCodec() = default;
+
+	virtual std::string_view GetName() const = 0;
+	virtual int GetMaxLevel() const = 0;
+
+	virtual bool Compress(const char* data, size_t size, int level, std::vector<char>& outData) const = 0;
+	virtual bool Decompress(const char* data, size_t size, size_t decompressedSize, std::vector<char>& outData) const = 0;
+
+	// nullptr if the backend isn't compiled in, empty name gives the default backend
+	static std::shared_ptr<EntryCodec> Create(std::string_view name = {});
+	static std::vector<std::string_view> GetAvailableCodecs();
+
+	static constexpr int DefaultLevel{ 6 };
+};
+
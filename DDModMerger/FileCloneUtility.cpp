@@ -3,28 +3,268 @@
 #include <algorithm>
 #include <execution>
 #include <filesystem>
+#include <fstream>
 
+#include "nlohmann/json.hpp"
 #include "utils.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "IOThrottle.h"
 
 namespace fs = std::filesystem;
 
 constexpr char BackupFolder[] = "./backup";
+constexpr char BackupBlobFolder[] = "blobs";
+constexpr char BackupManifestFileName[] = "manifest.json";
+
+fs::path GetBlobPath(std::string_view hash)
+{
+	return fs::path(BackupFolder) / BackupBlobFolder / (std::string(hash) + ".arc");
+}
 
 void FileCloneUtility::BackupMainFile(const powe::details::DirectoryTree& dirTree, const std::vector<std::string>& modsFiles)
 {
-	std::for_each(modsFiles.begin(), modsFiles.end(), [&dirTree,
-		searchFolder = std::string_view(m_SearchFolderPath)](const std::string& value)
+	std::for_each(modsFiles.begin(), modsFiles.end(), [&dirTree, this](const std::string& value)
 		{
 			const fs::path fileName{value};
 			if (auto pathToFile = dirTree.find(fileName.stem().string()); pathToFile != dirTree.end())
 			{
-				const auto& path{ pathToFile->second };
-
-				const fs::path fileAfterTopLevelFolder{ path.substr(searchFolder.size() + 1) }; // get rid of parent folder
-				const std::string pathToBackupFolder{ fs::path(BackupFolder / fileAfterTopLevelFolder.parent_path()).string() };
-				MakeBackup(path, pathToBackupFolder);
+				BackupFile(pathToFile->second);
 			}
 		});
+
+	SaveManifest();
+}
+
+powe::details::BackupFutures FileCloneUtility::BackupMainFileAsync(
+	const powe::details::DirectoryTree& dirTree,
+	const powe::details::ModsOverwriteOrder& overwriteOrder)
+{
+	powe::details::BackupFutures backupFutures{};
+
+	m_BackupFinished.store(0, std::memory_order_relaxed);
+	m_BackupTotal.store(0, std::memory_order_relaxed);
+
+	uint32_t backupCount{};
+	for (const auto& [fileName, pathToMods] : overwriteOrder)
+	{
+		if (dirTree.contains(fileName))
+			++backupCount;
+	}
+
+	m_BackupTotal.store(backupCount, std::memory_order_relaxed);
+
+	for (const auto& [fileName, pathToMods] : overwriteOrder)
+	{
+		const auto findItr = dirTree.find(fileName);
+		if (findItr == dirTree.end())
+			continue;
+
+		// one backup per main file no matter how many mods overwrite it
+		auto backup = [this, mainFilePath = findItr->second, backupCount]()
+			{
+				BackupFile(mainFilePath);
+
+				// the last backup to finish writes the manifest
+				if (m_BackupFinished.fetch_add(1, std::memory_order_acq_rel) + 1 == backupCount)
+				{
+					SaveManifest();
+				}
+			};
+
+		backupFutures.emplace(fileName, ThreadPool::Enqueue(backup).share());
+	}
+
+	return backupFutures;
+}
+
+void FileCloneUtility::RestoreAllAsync()
+{
+	if (!IsBackupFinished())
+	{
+		Logger::Warning("Backups are still being made, nothing restored");
+		return;
+	}
+
+	auto restoreAll = [this]()
+		{
+			std::unordered_map<std::string, BackupRecord> manifest{};
+			{
+				std::scoped_lock lock(m_ManifestMutex);
+				manifest = m_Manifest;
+			}
+
+			for (const auto& [relativePath, record] : manifest)
+			{
+				if (!RestoreFile(relativePath, record))
+				{
+					Logger::Error("Failed to restore ", relativePath);
+				}
+			}
+		};
+
+	ThreadPool::EnqueueDetach(restoreAll);
+}
+
+FileCloneUtility::BackupProgress FileCloneUtility::GetBackupProgress() const
+{
+	return BackupProgress{
+		m_BackupFinished.load(std::memory_order_relaxed),
+		m_BackupTotal.load(std::memory_order_relaxed) };
+}
+
+bool FileCloneUtility::IsBackupFinished() const
+{
+	// pairs with the count going up after a backup is written, what's counted is on disk
+	return m_BackupFinished.load(std::memory_order_acquire) >= m_BackupTotal.load(std::memory_order_acquire);
+}
+
+void FileCloneUtility::BackupFile(std::string_view mainFilePath)
+{
+	try
+	{
+		const std::string relativePath{ fs::path(mainFilePath.substr(m_SearchFolderPath.size() + 1)).generic_string() }; // get rid of parent folder
+		const uintmax_t fileSize{ fs::file_size(mainFilePath) };
+		const int64_t lastWriteTime{ GetLastWriteTimeCount(mainFilePath) };
+
+		// Same size and write time as the last backup, the file hasn't been touched since
+		{
+			std::scoped_lock lock(m_ManifestMutex);
+			if (const auto findItr = m_Manifest.find(relativePath); findItr != m_Manifest.end())
+			{
+				const auto& record{ findItr->second };
+				if (record.size == fileSize && record.lastWriteTime == lastWriteTime && fs::exists(GetBlobPath(record.hash)))
+					return;
+			}
+		}
+
+		// hashing and copying both read the whole archive from the install
+		const IOThrottle::Permit permit{ IOThrottle::Acquire(IODevice::Install, IOStage::Transfer, fileSize) };
+
+		std::string hash{};
+		{
+			const Tracer::Scope traceScope{ "hash", mainFilePath, fileSize };
+			hash = CalculateFileSHA256(mainFilePath);
+		}
+
+		if (hash.empty())
+		{
+			Logger::Error("Failed to hash ", mainFilePath);
+			return;
+		}
+
+		const fs::path blobPath{ GetBlobPath(hash) };
+		if (!fs::exists(blobPath))
+		{
+			// copy next to the blob first so a half written blob never has a valid name
+			fs::create_directories(blobPath.parent_path());
+			fs::path tempBlobPath{ blobPath };
+			tempBlobPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+			const Tracer::Scope traceScope{ "copy", mainFilePath, fileSize };
+			if (!CopyFileFast(mainFilePath, tempBlobPath))
+			{
+				Logger::Error("Failed to backup ", mainFilePath);
+				return;
+			}
+
+			fs::rename(tempBlobPath, blobPath);
+		}
+
+		std::scoped_lock lock(m_ManifestMutex);
+		m_Manifest[relativePath] = BackupRecord{ hash, fileSize, lastWriteTime };
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
+	}
+}
+
+bool FileCloneUtility::RestoreFile(const std::string& relativePath, const BackupRecord& record) const
+{
+	try
+	{
+		const fs::path blobPath{ GetBlobPath(record.hash) };
+		if (!fs::exists(blobPath))
+			return false;
+
+		const fs::path targetPath{ fs::path(m_SearchFolderPath) / relativePath };
+		fs::create_directories(targetPath.parent_path());
+
+		// Never hard link here, the game folder could be written in place and that would change the blob
+		return CopyFileFast(blobPath, targetPath);
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
+	}
+
+	return false;
+}
+
+void FileCloneUtility::LoadManifest()
+{
+	const fs::path manifestPath{ fs::path(BackupFolder) / BackupManifestFileName };
+
+	std::ifstream fileStream(manifestPath);
+	if (!fileStream.is_open())
+		return;
+
+	try
+	{
+		nlohmann::json json;
+		fileStream >> json;
+
+		for (const auto& [relativePath, value] : json.items())
+		{
+			m_Manifest[relativePath] = BackupRecord{
+				value.at("hash").get<std::string>(),
+				value.at("size").get<uintmax_t>(),
+				value.at("lastWriteTime").get<int64_t>() };
+		}
+	}
+	catch (const std::exception& e)
+	{
+		Logger::Error(e.what());
+		m_Manifest.clear();
+	}
+}
+
+void FileCloneUtility::SaveManifest()
+{
+	const fs::path manifestPath{ fs::path(BackupFolder) / BackupManifestFileName };
+
+	nlohmann::json json;
+	{
+		std::scoped_lock lock(m_ManifestMutex);
+		for (const auto& [relativePath, record] : m_Manifest)
+		{
+			json[relativePath] = {
+				{ "hash", record.hash },
+				{ "size", record.size },
+				{ "lastWriteTime", record.lastWriteTime } };
+		}
+	}
+
+	try
+	{
+		fs::create_directories(manifestPath.parent_path());
+
+		fs::path tempManifestPath{ manifestPath };
+		tempManifestPath += ".tmp";
+
+		{
+			std::ofstream outputFile(tempManifestPath);
+			outputFile << json.dump(4);
+		}
+
+		fs::rename(tempManifestPath, manifestPath);
+	}
+	catch (const std::exception& e)
+	{
+		Logger::Error("Failed to write to file: ", manifestPath, " ", e.what());
+	}
 }
 
 FileCloneUtility::FileCloneUtility(const CVarReader& cVarReader)
@@ -35,4 +275,6 @@ FileCloneUtility::FileCloneUtility(const CVarReader& cVarReader)
 	{
 		throw std::runtime_error("Error: -out, -path are required arguments");
 	}
+
+	LoadManifest();
 }
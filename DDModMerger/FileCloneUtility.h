@@ -1,24 +1,69 @@
 #pragma once
 
 #include <string>
+#include <atomic>
+#include <mutex>
 
 #include "Types.h"
 #include "CVarReader.h"
 
+/// <summary>
+/// Backups are stored by content. Every main file is hashed into ./backup/blobs/<sha256>.arc
+/// and ./backup/manifest.json maps the path inside the game folder to its blob,
+/// so a main file that is already stored only costs a manifest update
+/// </summary>
 class FileCloneUtility
 {
 public:
 
+	struct BackupProgress
+	{
+		uint32_t finished{};
+		uint32_t total{};
+	};
+
 	FileCloneUtility(const CVarReader& cVarReader);
 
 	void BackupMainFile(
 		const powe::details::DirectoryTree& dirTree,
 		const std::vector<std::string>& modsFiles);
 
+	/// <summary>
+	/// Backup every main file that is overwritten by the given order in the background.
+	/// Each file gets its own task so the merge of that file can start as soon as its backup is done
+	/// </summary>
+	powe::details::BackupFutures BackupMainFileAsync(
+		const powe::details::DirectoryTree& dirTree,
+		const powe::details::ModsOverwriteOrder& overwriteOrder);
+
+	// Copy every backed up file back to where it was in the game folder. Does nothing while backups are still running
+	void RestoreAllAsync();
+
+	BackupProgress GetBackupProgress() const;
+	bool IsBackupFinished() const;
+
 private:
 
+	struct BackupRecord
+	{
+		std::string hash;
+		uintmax_t size{};
+		int64_t lastWriteTime{};
+	};
+
+	void BackupFile(std::string_view mainFilePath);
+	bool RestoreFile(const std::string& relativePath, const BackupRecord& record) const;
+
+	void LoadManifest();
+	void SaveManifest();
+
+	std::unordered_map<std::string, BackupRecord> m_Manifest;
+	std::mutex m_ManifestMutex;
+
 	std::string m_SearchFolderPath;
 	std::string m_OutputFolder;
-	
+
+	std::atomic_uint32_t m_BackupFinished{};
+	std::atomic_uint32_t m_BackupTotal{};
 };
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Open addressing with linear probing, every entry lives in one array so an insert only allocates when the map grows.
+/// Each slot keeps the hash of its key, a probe compares hashes before keys and growing never hashes a key again.
+/// Meant for keys that are cheap to copy, like string_views into strings that outlive the map
+/// </summary>
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+class FlatHashMap
+{
+public:
+
+	explicit FlatHashMap(size_t expectedCount = 0)
+	{
+		Rehash(std::bit_ceil(std::max<size_t>(MinCapacity, expectedCount + expectedCount / 2)));
+	}
+
+	// Finds the key or inserts it with a default constructed value
+	Value& operator[](const Key& key)
+	{
+		// at most 3/4 full, past that the probes get long
+		if ((m_Count + 1) * 4 > m_Slots.size() * 3)
+			Rehash(m_Slots.size() * 2);
+
+		const uint64_t hash{ Hash{}(key) };
+		for (size_t index = hash & m_Mask;; index = (index + 1) & m_Mask)
+		{
+			Slot& slot{ m_Slots[index] };
+			if (!slot.used)
+			{
+				slot.hash = hash;
+				slot.key = key;
+				slot.used = true;
+				m_Count++;
+				return slot.value;
+			}
+
+			if (slot.hash == hash && KeyEqual{}(slot.key, key))
+				return slot.value;
+		}
+	}
+
+	size_t Size() const { return m_Count; }
+
+	// func(const Key&, Value&), in no particular order
+	template<typename Func>
+	void ForEach(Func&& func)
+	{
+		for (auto& slot : m_Slots)
+		{
+			if (slot.used)
+				func(std::as_const(slot.key), slot.value);
+		}
+	}
+
+private:
+
+	static constexpr size_t MinCapacity{ 16 };
+
+	struct Slot
+	{
+		uint64_t hash{};
+		Key key{};
+		Value value{};
+		bool used{};
+	};
+
+	void Rehash(size_t capacity)
+	{
+		std::vector<Slot> oldSlots(capacity);
+		oldSlots.swap(m_Slots);
+		m_Mask = capacity - 1;
+
+		for (auto& oldSlot : oldSlots)
+		{
+			if (!oldSlot.used)
+				continue;
+
+			size_t index{ oldSlot.hash & m_Mask };
+			while (m_Slots[index].used)
+			{
+				index = (index + 1) & m_Mask;
+			}
+
+			m_Slots[index] = std::move(oldSlot);
+		}
+	}
+
+	std::vector<Slot> m_Slots;
+	size_t m_Mask{};
+	size_t m_Count{};
+};
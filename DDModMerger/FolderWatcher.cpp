@@ -0,0 +1,358 @@
+#include "FolderWatcher.h"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+// a batch goes out once nothing happened for this long, or when the first change in it is this old
+constexpr auto QuietPeriod{ std::chrono::milliseconds(200) };
+constexpr auto MaxBatchDelay{ std::chrono::milliseconds(1000) };
+constexpr auto PollInterval{ std::chrono::milliseconds(50) };
+
+#ifdef _WIN32
+
+struct FolderWatcher::Backend
+{
+	explicit Backend(const fs::path& rootPath)
+		: rootPath(rootPath)
+	{
+		directory = CreateFileW(rootPath.c_str(), FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+			OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+		event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	}
+
+	~Backend()
+	{
+		if (pending)
+		{
+			CancelIoEx(directory, &overlapped);
+
+			DWORD bytes{};
+			GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+		}
+
+		if (event)
+			CloseHandle(event);
+
+		if (directory != INVALID_HANDLE_VALUE)
+			CloseHandle(directory);
+	}
+
+	bool IsOpen() const { return directory != INVALID_HANDLE_VALUE && event; }
+
+	bool Read(std::vector<Change>& changes, std::chrono::milliseconds timeout)
+	{
+		if (!pending)
+		{
+			overlapped = OVERLAPPED{};
+			overlapped.hEvent = event;
+
+			if (!ReadDirectoryChangesW(directory, buffer.data(), DWORD(buffer.size()), TRUE,
+				FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME, nullptr, &overlapped, nullptr))
+			{
+				Logger::Warning("Stopped watching ", rootPath, ", error ", GetLastError());
+				return false;
+			}
+
+			pending = true;
+		}
+
+		if (WaitForSingleObject(event, DWORD(timeout.count())) != WAIT_OBJECT_0)
+			return true;
+
+		pending = false;
+
+		DWORD bytes{};
+		if (!GetOverlappedResult(directory, &overlapped, &bytes, FALSE))
+		{
+			Logger::Warning("Stopped watching ", rootPath, ", error ", GetLastError());
+			return false;
+		}
+
+		// the buffer overflowed, what happened in the meantime is gone
+		if (bytes == 0)
+		{
+			changes.push_back({ Change::Type::Added, rootPath });
+			return true;
+		}
+
+		for (const std::byte* entry{ buffer.data() };;)
+		{
+			const auto* info{ reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry) };
+			const fs::path path{ rootPath / std::wstring_view(info->FileName, info->FileNameLength / sizeof(WCHAR)) };
+
+			switch (info->Action)
+			{
+			case FILE_ACTION_ADDED:
+			case FILE_ACTION_RENAMED_NEW_NAME:
+				changes.push_back({ Change::Type::Added, path });
+				break;
+			case FILE_ACTION_REMOVED:
+			case FILE_ACTION_RENAMED_OLD_NAME:
+				changes.push_back({ Change::Type::Removed, path });
+				break;
+			}
+
+			if (info->NextEntryOffset == 0)
+				break;
+
+			entry += info->NextEntryOffset;
+		}
+
+		return true;
+	}
+
+	fs::path rootPath;
+	HANDLE directory{ INVALID_HANDLE_VALUE };
+	HANDLE event{};
+	OVERLAPPED overlapped{};
+	bool pending{};
+
+	// ReadDirectoryChangesW wants it DWORD aligned
+	alignas(DWORD) std::array<std::byte, 64 * 1024> buffer{};
+};
+
+#elif defined(__linux__)
+
+namespace
+{
+	bool IsSameOrInside(const fs::path& path, const fs::path& folder)
+	{
+		return std::mismatch(folder.begin(), folder.end(), path.begin(), path.end()).first == folder.end();
+	}
+}
+
+// inotify only watches one directory at a time, every directory under the root gets its own watch
+struct FolderWatcher::Backend
+{
+	static constexpr uint32_t WatchMask{ IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR };
+
+	explicit Backend(const fs::path& rootPath)
+		: rootPath(rootPath)
+		, fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+	{
+		if (fd >= 0)
+			AddWatches(rootPath);
+	}
+
+	~Backend()
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+
+	bool IsOpen() const { return fd >= 0 && !watchPaths.empty(); }
+
+	// folder and everything under it
+	void AddWatches(const fs::path& folder)
+	{
+		AddWatch(folder);
+
+		std::error_code error{};
+		for (auto itr = fs::recursive_directory_iterator(folder, fs::directory_options::skip_permission_denied, error);
+			itr != fs::recursive_directory_iterator(); itr.increment(error))
+		{
+			if (itr->is_directory(error))
+				AddWatch(itr->path());
+		}
+	}
+
+	void AddWatch(const fs::path& folder)
+	{
+		const int watch{ inotify_add_watch(fd, folder.c_str(), WatchMask) };
+		if (watch < 0)
+		{
+			// usually fs.inotify.max_user_watches, say it once and not for every folder after it
+			const int error{ errno };
+			if (error != ENOSPC || !warnedAboutLimit)
+				Logger::Warning("Can't watch ", folder, ": ", std::strerror(error));
+
+			warnedAboutLimit = warnedAboutLimit || error == ENOSPC;
+			return;
+		}
+
+		// the same folder moved somewhere else keeps its watch, only the path changes
+		watchPaths[watch] = folder;
+	}
+
+	// A folder that moved out would keep reporting under its old path
+	void RemoveWatches(const fs::path& folder)
+	{
+		std::erase_if(watchPaths, [this, &folder](const auto& watchPath)
+			{
+				if (!IsSameOrInside(watchPath.second, folder))
+					return false;
+
+				inotify_rm_watch(fd, watchPath.first);
+				return true;
+			});
+	}
+
+	bool Read(std::vector<Change>& changes, std::chrono::milliseconds timeout)
+	{
+		pollfd pollFd{ fd, POLLIN, 0 };
+		const int result{ poll(&pollFd, 1, int(timeout.count())) };
+		if (result <= 0)
+			return result == 0 || errno == EINTR;
+
+		alignas(inotify_event) std::array<char, 16 * 1024> buffer;
+		const ssize_t length{ read(fd, buffer.data(), buffer.size()) };
+		if (length <= 0)
+			return length == 0 || errno == EAGAIN || errno == EINTR;
+
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const auto* event{ reinterpret_cast<const inotify_event*>(buffer.data() + offset) };
+			offset += ssize_t(sizeof(inotify_event) + event->len);
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				changes.push_back({ Change::Type::Added, rootPath });
+				continue;
+			}
+
+			const auto watchItr{ watchPaths.find(event->wd) };
+			if (watchItr == watchPaths.end())
+				continue;
+
+			// the kernel dropped the watch, the folder is gone
+			if (event->mask & IN_IGNORED)
+			{
+				watchPaths.erase(watchItr);
+				continue;
+			}
+
+			if (event->len == 0)
+				continue;
+
+			// copied out first, adding watches can rehash the map
+			const fs::path path{ watchItr->second / event->name };
+			const bool isDirectory{ (event->mask & IN_ISDIR) != 0 };
+
+			if (event->mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				if (isDirectory)
+					AddWatches(path);
+
+				changes.push_back({ Change::Type::Added, path });
+			}
+			else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				if (isDirectory)
+					RemoveWatches(path);
+
+				changes.push_back({ Change::Type::Removed, path });
+			}
+		}
+
+		// the root itself was deleted or moved
+		return !watchPaths.empty();
+	}
+
+	fs::path rootPath;
+	int fd{ -1 };
+	std::unordered_map<int, fs::path> watchPaths;
+	bool warnedAboutLimit{};
+};
+
+#else
+
+struct FolderWatcher::Backend
+{
+	explicit Backend(const fs::path&)
+	{
+	}
+
+	bool IsOpen() const { return false; }
+
+	bool Read(std::vector<Change>&, std::chrono::milliseconds)
+	{
+		return false;
+	}
+};
+
+#endif
+
+FolderWatcher::FolderWatcher(const fs::path& rootPath, Callback callback)
+	: m_RootPath(rootPath.has_filename() ? rootPath : rootPath.parent_path())
+	, m_Callback(std::move(callback))
+{
+	m_Backend = std::make_unique<Backend>(m_RootPath);
+	if (!m_Backend->IsOpen())
+	{
+		Logger::Warning("Can't watch ", m_RootPath, ", changes to it need a Refresh");
+		return;
+	}
+
+	m_Watching.store(true, std::memory_order_relaxed);
+	m_Thread = std::jthread([this](std::stop_token stopToken) { Run(stopToken); });
+
+	Logger::Info("Watching ", m_RootPath);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+	if (m_Thread.joinable())
+	{
+		m_Thread.request_stop();
+		m_Thread.join();
+	}
+}
+
+void FolderWatcher::Run(std::stop_token stopToken)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::vector<Change> changes{};
+	Clock::time_point firstChangeTime{};
+	Clock::time_point lastChangeTime{};
+
+	while (!stopToken.stop_requested())
+	{
+		const size_t changeCount{ changes.size() };
+		if (!ReadChanges(changes, PollInterval))
+			break;
+
+		const auto now{ Clock::now() };
+		if (changes.size() != changeCount)
+		{
+			if (changeCount == 0)
+				firstChangeTime = now;
+
+			lastChangeTime = now;
+		}
+
+		if (!changes.empty() && (now - lastChangeTime >= QuietPeriod || now - firstChangeTime >= MaxBatchDelay))
+		{
+			m_Callback(std::move(changes));
+			changes.clear();
+		}
+	}
+
+	if (!stopToken.stop_requested())
+		Logger::Warning("Stopped watching ", m_RootPath, ", changes to it need a Refresh");
+
+	m_Watching.store(false, std::memory_order_relaxed);
+}
+
+bool FolderWatcher::ReadChanges(std::vector<Change>& changes, std::chrono::milliseconds timeout)
+{
+	return m_Backend->Read(changes, timeout);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Follows everything under a folder and reports which paths showed up or went away.
+/// Changes come in batches on the watcher's own thread, once the folder has been quiet for a moment,
+/// so copying a whole mod in is one batch and not thousands.
+/// inotify on Linux and ReadDirectoryChangesW on Windows, anywhere else nothing gets reported
+/// </summary>
+class FolderWatcher
+{
+public:
+
+	struct Change
+	{
+		enum class Type
+		{
+			Added, // created or moved in
+			Removed // deleted or moved out, a rename is a Removed and an Added
+		};
+
+		Type type;
+
+		// The root itself when events were lost, everything under it should be looked at again
+		std::filesystem::path path;
+	};
+
+	using Callback = std::function<void(std::vector<Change>&& changes)>;
+
+	FolderWatcher(const std::filesystem::path& rootPath, Callback callback);
+	~FolderWatcher();
+
+	FolderWatcher(const FolderWatcher&) = delete;
+	FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+	// False when the platform has no watcher, the folder can't be opened or it was deleted
+	bool IsWatching() const { return m_Watching.load(std::memory_order_relaxed); }
+
+private:
+
+	void Run(std::stop_token stopToken);
+
+	// Waits up to timeout for events and adds them to changes. False once nothing can be watched anymore
+	bool ReadChanges(std::vector<Change>& changes, std::chrono::milliseconds timeout);
+
+	struct Backend;
+	std::unique_ptr<Backend> m_Backend;
+
+	std::filesystem::path m_RootPath;
+	Callback m_Callback;
+	std::atomic<bool> m_Watching{};
+
+	// last, it has to stop before anything it uses goes away
+	std::jthread m_Thread;
+};
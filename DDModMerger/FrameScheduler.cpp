@@ -0,0 +1,36 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+void FrameScheduler::SetWakeHandler(void (*wakeHandler)())
+{
+	s_WakeHandler.store(wakeHandler, std::memory_order_release);
+}
+
+void FrameScheduler::Wake()
+{
+	// the loop clears it when it starts a frame, until then one posted event is enough
+	if (s_WakePending.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	if (auto wakeHandler = s_WakeHandler.load(std::memory_order_acquire))
+		wakeHandler();
+}
+
+void FrameScheduler::RequestFrameWithin(double interval)
+{
+	interval = std::max(interval, 1.0 / MaxAnimationRate);
+
+	if (s_RequestedInterval < 0.0 || interval < s_RequestedInterval)
+		s_RequestedInterval = interval;
+}
+
+double FrameScheduler::TakeWaitTimeout(double idleTimeout)
+{
+	s_WakePending.store(false, std::memory_order_release);
+
+	const double timeout{ s_RequestedInterval < 0.0 ? idleTimeout : std::min(idleTimeout, s_RequestedInterval) };
+	s_RequestedInterval = -1.0;
+
+	return timeout;
+}
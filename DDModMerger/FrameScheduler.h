@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <type_traits>
+
+/// <summary>
+/// Decides when the UI draws. The main loop sleeps until there's input, a background task calls Wake,
+/// or a widget asked for a frame (an animation, live counters). Animations never go above MaxAnimationRate
+/// </summary>
+class FrameScheduler
+{
+public:
+
+	static constexpr double MaxAnimationRate{ 15.0 };
+
+	// What the UI polls and the std::async that produces it. Destroying thread waits for the task like std::async does
+	template<typename T>
+	struct AsyncResult
+	{
+		std::future<T> result;
+		std::future<void> thread;
+	};
+
+	// How the main loop gets woken up, glfwPostEmptyEvent. Has to be safe to call from any thread
+	static void SetWakeHandler(void (*wakeHandler)());
+
+	// Any thread: something the UI shows has changed. Calls between two frames are folded into one wake up
+	static void Wake();
+
+	// Any thread: std::async that wakes the UI once result is ready. A Wake from inside func
+	// comes before the result is set, so the frame it wakes could still find the future not ready
+	template<typename Func>
+	static AsyncResult<std::invoke_result_t<std::decay_t<Func>&>> Async(Func&& func);
+
+	// UI thread while drawing: draw again in at most interval seconds
+	static void RequestFrameWithin(double interval);
+
+	// Main loop, once per frame: how long it may wait for events, clears the requests for the next frame
+	static double TakeWaitTimeout(double idleTimeout);
+
+private:
+
+	static inline std::atomic<void (*)()> s_WakeHandler{};
+	static inline std::atomic_bool s_WakePending{};
+	static inline double s_RequestedInterval{ -1.0 }; // only touched by the UI thread
+};
+
+template<typename Func>
+inline FrameScheduler::AsyncResult<std::invoke_result_t<std::decay_t<Func>&>> FrameScheduler::Async(Func&& func)
+{
+	std::packaged_task<std::invoke_result_t<std::decay_t<Func>&>()> task{ std::forward<Func>(func) };
+	auto result{ task.get_future() };
+
+	auto thread{ std::async(std::launch::async, [task = std::move(task)]() mutable
+		{
+			task();
+			Wake();
+		}) };
+
+	return { std::move(result), std::move(thread) };
+}
@@ -0,0 +1,255 @@
+#include "IOThrottle.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "ThreadPoolMetrics.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr uint32_t InitialLimit{ 4 };
+	constexpr uint32_t MaxLimit{ 64 };
+	constexpr auto MeasureWindow{ std::chrono::milliseconds(500) };
+
+	// anything between these two is noise, the limit stays where it is
+	constexpr double IncreaseThreshold{ 1.05 };
+	constexpr double DecreaseThreshold{ 0.85 };
+
+	struct StageController
+	{
+		std::mutex mutex;
+		std::condition_variable_any releaseCV;
+
+		uint32_t limit{ InitialLimit };
+		uint32_t inFlight{};
+		uint64_t completedCount{};
+
+		std::chrono::steady_clock::time_point windowStart{ std::chrono::steady_clock::now() };
+		uint64_t windowAmount{};
+		uint32_t windowCompleted{};
+		bool windowSaturated{}; // the limit held work back at some point in this window
+
+		double lastThroughput{}; // the last window where the limit was the bottleneck
+		double throughput{};
+
+		// called with the mutex held once a window is over
+		void Adjust(std::chrono::steady_clock::time_point now)
+		{
+			const double seconds{ std::chrono::duration<double>(now - windowStart).count() };
+			throughput = double(windowAmount) / seconds;
+
+			// when the limit isn't reached there's not enough work to tell anything
+			if (windowSaturated)
+			{
+				if (lastThroughput == 0.0 || throughput > lastThroughput * IncreaseThreshold)
+				{
+					limit = std::min(MaxLimit, limit + 1);
+				}
+				else if (throughput < lastThroughput * DecreaseThreshold)
+				{
+					limit = std::max(1u, limit - std::max(1u, limit / 4));
+				}
+
+				lastThroughput = throughput;
+			}
+
+			ResetWindow();
+		}
+
+		void ResetWindow()
+		{
+			windowStart = std::chrono::steady_clock::now();
+			windowAmount = 0;
+			windowCompleted = 0;
+			windowSaturated = inFlight >= limit;
+		}
+	};
+
+	struct ThrottleState
+	{
+		std::array<std::array<StageController, size_t(IOStage::Count)>, size_t(IODevice::Count)> controllers;
+
+		std::mutex rootsMutex;
+		std::array<std::string, size_t(IODevice::Count)> roots;
+	};
+
+	ThrottleState& GetState()
+	{
+		static ThrottleState state{};
+		return state;
+	}
+
+	StageController& GetController(IODevice device, IOStage stage)
+	{
+		return GetState().controllers[size_t(device)][size_t(stage)];
+	}
+
+	std::string NormalizePath(const fs::path& path)
+	{
+		std::string normalPath{ path.lexically_normal().generic_string() };
+		while (normalPath.size() > 1 && normalPath.back() == '/')
+		{
+			normalPath.pop_back();
+		}
+
+		return normalPath;
+	}
+}
+
+std::string_view GetIODeviceName(IODevice device)
+{
+	switch (device)
+	{
+	case IODevice::Install:
+		return "Install";
+	case IODevice::Mods:
+		return "Mods";
+	case IODevice::Staging:
+		return "Staging";
+	default:
+		return "Other";
+	}
+}
+
+IOThrottle::Permit::Permit(IODevice device, IOStage stage, uint64_t amount)
+	: m_Device(device)
+	, m_Stage(stage)
+	, m_Amount(amount)
+	, m_Valid(true)
+{
+}
+
+IOThrottle::Permit::Permit(Permit&& other) noexcept
+	: m_Device(other.m_Device)
+	, m_Stage(other.m_Stage)
+	, m_Amount(other.m_Amount)
+	, m_Valid(std::exchange(other.m_Valid, false))
+{
+}
+
+IOThrottle::Permit& IOThrottle::Permit::operator=(Permit&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (m_Valid)
+			Release(m_Device, m_Stage, m_Amount);
+
+		m_Device = other.m_Device;
+		m_Stage = other.m_Stage;
+		m_Amount = other.m_Amount;
+		m_Valid = std::exchange(other.m_Valid, false);
+	}
+
+	return *this;
+}
+
+IOThrottle::Permit::~Permit()
+{
+	if (m_Valid)
+		Release(m_Device, m_Stage, m_Amount);
+}
+
+void IOThrottle::SetDeviceRoot(IODevice device, const fs::path& root)
+{
+	auto& state{ GetState() };
+
+	std::scoped_lock lock(state.rootsMutex);
+	state.roots[size_t(device)] = root.empty() ? std::string() : NormalizePath(root);
+}
+
+IODevice IOThrottle::GetDevice(std::string_view path)
+{
+	auto& state{ GetState() };
+	const std::string normalPath{ NormalizePath(path) };
+
+	IODevice device{ IODevice::Other };
+	size_t matchLength{};
+
+	std::scoped_lock lock(state.rootsMutex);
+	for (size_t i = 0; i < state.roots.size(); i++)
+	{
+		const std::string& root{ state.roots[i] };
+		if (root.empty() || root.size() <= matchLength || !normalPath.starts_with(root))
+			continue;
+
+		// "mods" shouldn't match "modsBackup/..."
+		if (normalPath.size() != root.size() && normalPath[root.size()] != '/')
+			continue;
+
+		device = IODevice(i);
+		matchLength = root.size();
+	}
+
+	return device;
+}
+
+IOThrottle::Permit IOThrottle::Acquire(
+	IODevice device,
+	IOStage stage,
+	uint64_t amount,
+	std::stop_token stopToken,
+	uint32_t maxInFlight)
+{
+	auto& controller{ GetController(device, stage) };
+	maxInFlight = std::max(1u, maxInFlight);
+
+	std::unique_lock lock(controller.mutex);
+
+	auto hasRoom = [&controller, maxInFlight]()
+		{
+			return controller.inFlight < std::min(controller.limit, maxInFlight);
+		};
+
+	if (!hasRoom())
+	{
+		controller.windowSaturated = true;
+
+		const ThreadPoolMetrics::BlockScope blockScope{};
+		if (!controller.releaseCV.wait(lock, stopToken, hasRoom))
+			return Permit{};
+	}
+
+	// coming back from idle, the time nothing ran says nothing about the device
+	if (controller.inFlight == 0 && std::chrono::steady_clock::now() - controller.windowStart >= MeasureWindow)
+		controller.ResetWindow();
+
+	controller.inFlight++;
+	if (controller.inFlight >= controller.limit)
+		controller.windowSaturated = true;
+
+	return Permit{ device, stage, amount };
+}
+
+IOThrottle::Stats IOThrottle::GetStats(IODevice device, IOStage stage)
+{
+	auto& controller{ GetController(device, stage) };
+
+	std::scoped_lock lock(controller.mutex);
+	return Stats{ controller.limit, controller.inFlight, controller.completedCount, controller.throughput };
+}
+
+void IOThrottle::Release(IODevice device, IOStage stage, uint64_t amount)
+{
+	auto& controller{ GetController(device, stage) };
+	{
+		std::scoped_lock lock(controller.mutex);
+		controller.inFlight--;
+		controller.completedCount++;
+		controller.windowAmount += amount;
+		controller.windowCompleted++;
+
+		const auto now{ std::chrono::steady_clock::now() };
+		if (now - controller.windowStart >= MeasureWindow && controller.windowCompleted > 1)
+			controller.Adjust(now);
+	}
+
+	// the limit could have gone up by one
+	controller.releaseCV.notify_all();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <stop_token>
+#include <string_view>
+
+// The places we read and write, each one could be a different disk
+enum class IODevice : uint8_t
+{
+	Install,
+	Mods,
+	Staging,
+	Other,
+	Count
+};
+
+// Scans are measured in entries, transfers in bytes
+enum class IOStage : uint8_t
+{
+	Scan,
+	Transfer,
+	Count
+};
+
+std::string_view GetIODeviceName(IODevice device);
+
+/// <summary>
+/// Limits how much I/O is in flight per device and stage, and tunes the limit from the throughput it measures.
+/// While the limit is the bottleneck it's raised by one as long as the throughput keeps going up (additive increase)
+/// and cut by a quarter when it drops (multiplicative decrease), so an NVMe drive ends up with many tasks
+/// and a spinning disk with one or two
+/// </summary>
+class IOThrottle
+{
+public:
+
+	// Reports what got done when it goes out of scope
+	class Permit
+	{
+	public:
+
+		Permit() = default;
+		Permit(IODevice device, IOStage stage, uint64_t amount);
+		Permit(Permit&& other) noexcept;
+		Permit& operator=(Permit&& other) noexcept;
+		~Permit();
+
+		Permit(const Permit&) = delete;
+		Permit& operator=(const Permit&) = delete;
+
+		// false when the wait was cancelled
+		bool IsValid() const { return m_Valid; }
+
+		// for work whose size is only known once it's done
+		void SetAmount(uint64_t amount) { m_Amount = amount; }
+
+	private:
+
+		IODevice m_Device{};
+		IOStage m_Stage{};
+		uint64_t m_Amount{};
+		bool m_Valid{};
+	};
+
+	struct Stats
+	{
+		uint32_t limit{};
+		uint32_t inFlight{};
+		uint64_t completedCount{};
+		double throughput{}; // per second over the last window, bytes or entries
+	};
+
+	// Paths under root belong to the device, the longest root wins
+	static void SetDeviceRoot(IODevice device, const std::filesystem::path& root);
+	static IODevice GetDevice(std::string_view path);
+
+	// Blocks until there's room on the device, gives back an invalid permit if stopToken is triggered first.
+	// maxInFlight caps the limit for callers that can't have more than that many tasks in flight
+	[[nodiscard]] static Permit Acquire(
+		IODevice device,
+		IOStage stage,
+		uint64_t amount,
+		std::stop_token stopToken = {},
+		uint32_t maxInFlight = UINT32_MAX);
+
+	[[nodiscard]] static Permit Acquire(
+		std::string_view path,
+		IOStage stage,
+		uint64_t amount,
+		std::stop_token stopToken = {})
+	{
+		return Acquire(GetDevice(path), stage, amount, stopToken);
+	}
+
+	static Stats GetStats(IODevice device, IOStage stage);
+
+private:
+
+	static void Release(IODevice device, IOStage stage, uint64_t amount);
+};
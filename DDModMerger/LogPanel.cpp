@@ -0,0 +1,85 @@
+#include "LogPanel.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+
+constexpr float LogPanelHeight{ 200.0f };
+
+void LogPanel::Draw()
+{
+	m_Open = ImGui::CollapsingHeader("Log");
+	if (!m_Open)
+		return;
+
+	// don't copy the history every frame, only when there's something new
+	const uint64_t historyVersion{ Logger::GetHistoryVersion() };
+	if (historyVersion != m_HistoryVersion || m_MinLevel != m_CachedMinLevel)
+	{
+		m_Lines = Logger::GetHistory(LogLevel(m_MinLevel));
+		m_HistoryVersion = historyVersion;
+		m_CachedMinLevel = m_MinLevel;
+	}
+
+	const char* levelNames[]{ "Debug", "Info", "Warning", "Error" };
+	ImGui::SetNextItemWidth(120.0f);
+	if (ImGui::Combo("Level", &m_MinLevel, levelNames, IM_ARRAYSIZE(levelNames)))
+	{
+		// debug lines aren't even formatted unless someone wants them, above that -log-level stays what it was
+		Logger::SetMinLevel(LogLevel(std::min(m_MinLevel, int(m_StartLevel))));
+	}
+
+	ImGui::SameLine();
+	ImGui::Checkbox("Auto-scroll", &m_AutoScroll);
+
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Clear"))
+	{
+		Logger::ClearHistory();
+	}
+
+	if (const uint64_t droppedCount{ Logger::GetDroppedCount() })
+	{
+		ImGui::SameLine();
+		ImGui::TextDisabled("(%llu dropped)", static_cast<unsigned long long>(droppedCount));
+	}
+
+	if (ImGui::BeginChild("LogLines", ImVec2(-1.0f, LogPanelHeight), ImGuiChildFlags_Border))
+	{
+		ImGuiListClipper clipper{};
+		clipper.Begin(int(m_Lines.size()));
+		while (clipper.Step())
+		{
+			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+			{
+				const auto& line{ m_Lines[i] };
+
+				ImVec4 color{ 1.0f, 1.0f, 1.0f, 1.0f };
+				if (line.level == LogLevel::Error)
+					color = ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
+				else if (line.level == LogLevel::Warning)
+					color = ImVec4(1.0f, 0.8f, 0.3f, 1.0f);
+				else if (line.level == LogLevel::Debug)
+					color = ImVec4(0.6f, 0.6f, 0.6f, 1.0f);
+
+				ImGui::PushStyleColor(ImGuiCol_Text, color);
+				ImGui::TextUnformatted(line.text.c_str(), line.text.c_str() + line.text.size());
+				ImGui::PopStyleColor();
+			}
+		}
+		clipper.End();
+
+		if (m_AutoScroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+			ImGui::SetScrollHereY(1.0f);
+	}
+	ImGui::EndChild();
+}
+
+float LogPanel::GetReservedHeight() const
+{
+	float height{ ImGui::GetFrameHeightWithSpacing() };
+	if (m_Open)
+		height += ImGui::GetFrameHeightWithSpacing() + LogPanelHeight + ImGui::GetStyle().ItemSpacing.y;
+
+	return height;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Widget.h"
+
+#include "Logger.h"
+
+#include <vector>
+
+/// <summary>
+/// Shows what the logger drained so far, filtered by level.
+/// Only copies the history when the logger says something new came in
+/// </summary>
+class LogPanel : public Widget
+{
+public:
+
+	LogPanel() = default;
+
+	void Draw() override;
+	~LogPanel() = default;
+
+	// Room the panel takes under the merge area, open or not
+	float GetReservedHeight() const;
+
+private:
+
+	std::vector<Logger::Line> m_Lines{};
+	uint64_t m_HistoryVersion{ ~uint64_t(0) };
+
+	// what -log-level set, the panel only ever lowers the logger's level below it
+	LogLevel m_StartLevel{ Logger::GetMinLevel() };
+	int m_MinLevel{ int(m_StartLevel) };
+	int m_CachedMinLevel{ -1 };
+
+	bool m_AutoScroll{ true };
+	bool m_Open{};
+};
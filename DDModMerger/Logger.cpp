@@ -1 +1,309 @@
-#include "Logger.h"
\ No newline at end of file
+#include "Logger.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include "FrameScheduler.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr size_t RingCapacity{ 1024 };
+	constexpr size_t HistoryCapacity{ 5000 };
+	constexpr auto DrainInterval{ std::chrono::milliseconds(20) };
+
+	// Single producer (the owning thread), single consumer (the drain thread)
+	struct LogRing
+	{
+		std::array<Logger::Line, RingCapacity> lines;
+		alignas(64) std::atomic<size_t> head{}; // next to write, only the owner moves it
+		alignas(64) std::atomic<size_t> tail{}; // next to read, only the drain thread moves it
+
+		bool TryPush(Logger::Line&& line)
+		{
+			const size_t currentHead{ head.load(std::memory_order_relaxed) };
+			if (currentHead - tail.load(std::memory_order_acquire) == RingCapacity)
+				return false;
+
+			lines[currentHead % RingCapacity] = std::move(line);
+			head.store(currentHead + 1, std::memory_order_release);
+			return true;
+		}
+
+		template<typename Func>
+		void PopAll(Func&& func)
+		{
+			const size_t currentHead{ head.load(std::memory_order_acquire) };
+			size_t currentTail{ tail.load(std::memory_order_relaxed) };
+
+			for (; currentTail != currentHead; currentTail++)
+			{
+				func(std::move(lines[currentTail % RingCapacity]));
+			}
+
+			tail.store(currentTail, std::memory_order_release);
+		}
+	};
+
+	struct LoggerState
+	{
+		const std::chrono::steady_clock::time_point startTime{ std::chrono::steady_clock::now() };
+		std::atomic<LogLevel> minLevel{ LogLevel::Info };
+		std::atomic<uint64_t> droppedCount{};
+
+		std::mutex ringsMutex;
+		std::vector<std::unique_ptr<LogRing>> rings;
+
+		std::mutex drainMutex;
+		std::condition_variable_any drainCV;
+		std::jthread drainThread;
+		std::ofstream logFile;
+
+		std::mutex historyMutex;
+		std::deque<Logger::Line> history;
+		std::atomic<uint64_t> historyVersion{};
+	};
+
+	LoggerState& GetState()
+	{
+		static LoggerState state{};
+		return state;
+	}
+
+	LogRing& GetThreadRing()
+	{
+		// registering takes the lock once per thread, pushing after that doesn't
+		thread_local LogRing* threadRing{ []()
+			{
+				auto& state{ GetState() };
+				std::scoped_lock lock(state.ringsMutex);
+				return state.rings.emplace_back(std::make_unique<LogRing>()).get();
+			}() };
+
+		return *threadRing;
+	}
+
+	void WriteToConsole(const Logger::Line& line)
+	{
+		std::ostream& stream{ line.level >= LogLevel::Warning ? std::cerr : std::cout };
+
+#ifdef _WIN32
+		if (line.level == LogLevel::Error)
+			SetConsoleTextAttribute(GetStdHandle(STD_ERROR_HANDLE), FOREGROUND_RED);
+#endif
+
+		stream << '[' << GetLogLevelName(line.level) << "] " << line.text << '\n';
+
+#ifdef _WIN32
+		if (line.level == LogLevel::Error)
+			SetConsoleTextAttribute(GetStdHandle(STD_ERROR_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+#endif
+	}
+
+	// Only ever runs on the drain thread, or on the caller of Shutdown after it's joined.
+	// False when there was nothing to drain
+	bool Drain()
+	{
+		auto& state{ GetState() };
+
+		std::vector<Logger::Line> lines{};
+		{
+			std::scoped_lock lock(state.ringsMutex);
+			for (const auto& ring : state.rings)
+			{
+				ring->PopAll([&lines](Logger::Line&& line) { lines.emplace_back(std::move(line)); });
+			}
+		}
+
+		if (lines.empty())
+			return false;
+
+		// every ring is in order on its own, this puts the threads back together
+		std::stable_sort(lines.begin(), lines.end(), [](const Logger::Line& lhs, const Logger::Line& rhs)
+			{
+				return lhs.time < rhs.time;
+			});
+
+		for (const auto& line : lines)
+		{
+			WriteToConsole(line);
+
+			if (state.logFile.is_open())
+			{
+				state.logFile << line.time << " [" << GetLogLevelName(line.level) << "] " << line.text << '\n';
+			}
+		}
+
+		if (state.logFile.is_open())
+			state.logFile.flush();
+
+		{
+			std::scoped_lock lock(state.historyMutex);
+			for (auto& line : lines)
+			{
+				state.history.emplace_back(std::move(line));
+			}
+
+			while (state.history.size() > HistoryCapacity)
+			{
+				state.history.pop_front();
+			}
+		}
+
+		state.historyVersion.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+}
+
+std::string_view GetLogLevelName(LogLevel level)
+{
+	switch (level)
+	{
+	case LogLevel::Debug:
+		return "debug";
+	case LogLevel::Info:
+		return "info";
+	case LogLevel::Warning:
+		return "warning";
+	case LogLevel::Error:
+		return "error";
+	}
+
+	return "info";
+}
+
+LogLevel ParseLogLevel(std::string_view levelName)
+{
+	for (const LogLevel level : { LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Error })
+	{
+		if (GetLogLevelName(level) == levelName)
+			return level;
+	}
+
+	return LogLevel::Info;
+}
+
+void Logger::Init(const fs::path& logFilePath, LogLevel minLevel)
+{
+	auto& state{ GetState() };
+	state.minLevel.store(minLevel, std::memory_order_relaxed);
+
+	if (!logFilePath.empty())
+	{
+		state.logFile.open(logFilePath, std::ios::trunc);
+		if (!state.logFile)
+		{
+			std::cerr << "Error: Can't open log file " << logFilePath << '\n';
+		}
+	}
+
+	state.drainThread = std::jthread([](std::stop_token stopToken)
+		{
+			auto& state{ GetState() };
+			while (!stopToken.stop_requested())
+			{
+				// the log panel has something new to show, an idle log doesn't keep the UI drawing
+				if (Drain())
+					FrameScheduler::Wake();
+
+				std::unique_lock lock(state.drainMutex);
+				state.drainCV.wait_for(lock, stopToken, DrainInterval, [] { return false; });
+			}
+		});
+}
+
+void Logger::Shutdown()
+{
+	auto& state{ GetState() };
+	if (state.drainThread.joinable())
+	{
+		state.drainThread.request_stop();
+		state.drainThread.join();
+	}
+
+	Drain();
+
+	if (const uint64_t droppedCount{ state.droppedCount.load(std::memory_order_relaxed) })
+	{
+		std::cerr << "[warning] " << droppedCount << " log lines were dropped\n";
+	}
+
+	state.logFile.close();
+}
+
+void Logger::SetMinLevel(LogLevel level)
+{
+	GetState().minLevel.store(level, std::memory_order_relaxed);
+}
+
+LogLevel Logger::GetMinLevel()
+{
+	return GetState().minLevel.load(std::memory_order_relaxed);
+}
+
+bool Logger::IsEnabled(LogLevel level)
+{
+	return level >= GetState().minLevel.load(std::memory_order_relaxed);
+}
+
+void Logger::Push(LogLevel level, std::string text)
+{
+	auto& state{ GetState() };
+
+	const auto elapsed{ std::chrono::steady_clock::now() - state.startTime };
+	Line line{ uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()), level, std::move(text) };
+
+	if (!GetThreadRing().TryPush(std::move(line)))
+		state.droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<Logger::Line> Logger::GetHistory(LogLevel minLevel)
+{
+	auto& state{ GetState() };
+
+	std::vector<Line> lines{};
+	std::scoped_lock lock(state.historyMutex);
+	for (const auto& line : state.history)
+	{
+		if (line.level >= minLevel)
+			lines.emplace_back(line);
+	}
+
+	return lines;
+}
+
+uint64_t Logger::GetHistoryVersion()
+{
+	return GetState().historyVersion.load(std::memory_order_acquire);
+}
+
+uint64_t Logger::GetDroppedCount()
+{
+	return GetState().droppedCount.load(std::memory_order_relaxed);
+}
+
+void Logger::ClearHistory()
+{
+	auto& state{ GetState() };
+	{
+		std::scoped_lock lock(state.historyMutex);
+		state.history.clear();
+	}
+
+	state.historyVersion.fetch_add(1, std::memory_order_release);
+}
@@ -1,14 +1,89 @@
 #pragma once
 
-#include "Widget.h"
+#include <cstdint>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
+enum class LogLevel : uint8_t
+{
+	Debug,
+	Info,
+	Warning,
+	Error
+};
+
+std::string_view GetLogLevelName(LogLevel level);
+
+// "debug", "info", "warning" or "error", anything else is Info
+LogLevel ParseLogLevel(std::string_view levelName);
+
+/// <summary>
+/// Logging that never makes the caller wait on the console.
+/// Every thread pushes into its own ring buffer, one background thread drains them
+/// in time order to the console, the log file and the history the log panel shows.
+/// When a ring is full the message is dropped and counted instead of blocking
+/// </summary>
 class Logger
 {
 public:
 
+	struct Line
+	{
+		uint64_t time{}; // milliseconds since the logger started
+		LogLevel level{};
+		std::string text;
+	};
 
-private:
+	// Starts the drain thread, an empty path keeps the log off the disk
+	static void Init(const std::filesystem::path& logFilePath, LogLevel minLevel);
+
+	// Drains whatever is left and stops the thread
+	static void Shutdown();
+
+	static void SetMinLevel(LogLevel level);
+	static LogLevel GetMinLevel();
+	static bool IsEnabled(LogLevel level);
+
+	template<typename... Args>
+	static void Log(LogLevel level, const Args&... args);
 
+	template<typename... Args>
+	static void Debug(const Args&... args) { Log(LogLevel::Debug, args...); }
 
+	template<typename... Args>
+	static void Info(const Args&... args) { Log(LogLevel::Info, args...); }
+
+	template<typename... Args>
+	static void Warning(const Args&... args) { Log(LogLevel::Warning, args...); }
+
+	template<typename... Args>
+	static void Error(const Args&... args) { Log(LogLevel::Error, args...); }
+
+	// Lines kept for the UI, oldest first. Only the last few thousand are kept
+	static std::vector<Line> GetHistory(LogLevel minLevel);
+	static uint64_t GetHistoryVersion();
+	static uint64_t GetDroppedCount();
+	static void ClearHistory();
+
+private:
+
+	static void Push(LogLevel level, std::string text);
 };
 
+template<typename... Args>
+void Logger::Log(LogLevel level, const Args&... args)
+{
+	// nothing gets formatted for a level nobody reads
+	if (!IsEnabled(level))
+		return;
+
+	thread_local std::ostringstream stream{};
+	stream.str({});
+	stream.clear();
+	(stream << ... << args);
+
+	Push(level, std::move(stream).str());
+}
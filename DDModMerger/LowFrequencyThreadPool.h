@@ -1,55 +1,54 @@
 #pragma once
 #include "Types.h"
-#include "thread_pool/thread_pool.h"
+#include "WorkerPool.h"
 
 #include <barrier>
 
 /// <summary>
-/// This implementation of thread pool is loosely way to implement dynamic resizing thread pool
-/// Don't follow this meothod for professional use
+/// Pool for the long running work that mostly waits (compares, merges on the old path)
+/// so it doesn't take workers away from the main pool
 /// </summary>
 class LowFrequencyThreadPool
 {
 public:
 
-	using threadImpl = dp::thread_pool<std::function<void()>, std::jthread>;
-
+	// Resizes the pool in place, work that's queued or running carries on
 	static void Init(uint32_t threadCount)
 	{
-		auto& instance = LowFrequencyThreadPool::GetInstance();
-		auto& threadPool = instance.GetThreadPoolImpl();
-		if (threadPool->size() != threadCount)
-		{
-			threadPool = std::make_shared<threadImpl>(threadCount);
-		}
+		GetInstance().m_WorkerPool.Resize(threadCount);
 	}
 
 	static uint32_t Size()
 	{
-		auto& instance{ GetInstance() };
-		return static_cast<uint32_t>(instance.GetThreadPoolImpl()->size());
+		return GetInstance().m_WorkerPool.Size();
+	}
+
+	static ThreadPoolMetrics::Snapshot GetMetrics()
+	{
+		return GetInstance().m_WorkerPool.GetMetrics();
+	}
+
+	static void ResetLatencies()
+	{
+		GetInstance().m_WorkerPool.ResetLatencies();
 	}
 
 	template<typename Func, typename... Args>
 	static std::future<std::invoke_result_t<Func, Args...>> Enqueue(Func&& func, Args&&... args)
 	{
-		auto& instance{ GetInstance() };
-		auto& threadPool{ instance.GetThreadPoolImpl() };
-		return threadPool->enqueue(std::forward<Func>(func), std::forward<Args>(args)...);
+		return GetInstance().m_WorkerPool.Enqueue(std::forward<Func>(func), std::forward<Args>(args)...);
 	}
 
 	template<typename Func, typename... Args>
 	static void EnqueueDetach(Func&& func, Args&&... args)
 	{
-		auto& instance{ GetInstance() };
-		auto& threadPool{ instance.GetThreadPoolImpl() };
-		threadPool->enqueue_detach(std::forward<Func>(func), std::forward<Args>(args)...);
+		GetInstance().m_WorkerPool.EnqueueDetach(std::forward<Func>(func), std::forward<Args>(args)...);
 	}
 
 private:
 
 	LowFrequencyThreadPool()
-		: m_ThreadPool(std::make_shared<threadImpl>(std::thread::hardware_concurrency()))
+		: m_WorkerPool(std::thread::hardware_concurrency())
 	{
 	}
 
@@ -62,8 +61,5 @@ private:
 		return threadPool;
 	}
 
-	std::shared_ptr<threadImpl>& GetThreadPoolImpl() { return m_ThreadPool; }
-
-	std::shared_ptr<threadImpl> m_ThreadPool;
+	WorkerPool m_WorkerPool;
 };
-
@@ -7,17 +7,56 @@
 #include "ModMerger.h"
 #include "ThreadPool.h"
 #include "FileCloneUtility.h"
+#include "FrameScheduler.h"
 
-void MenuBar::Draw()
+#include <algorithm>
+
+namespace
 {
+	constexpr int MaxThreadCount{ 48 };
 
-	if (ImGui::Button("Refresh"))
+	struct ThreadCountSuggestion
 	{
-		if (m_MergeTask->IsFinished())
+		int threadCount{};
+		const char* reason{};
+	};
+
+	// What the main pool is doing right now says whether it wants more or fewer workers,
+	// no suggestion when it looks fine
+	ThreadCountSuggestion SuggestThreadCount(const ThreadPoolMetrics::Snapshot& snapshot)
+	{
+		const int hardwareThreads{ std::max(1, int(std::thread::hardware_concurrency())) };
+		const int workerCount{ int(snapshot.workerCount) };
+		const uint64_t runningCount{ snapshot.activeCount - snapshot.blockedCount };
+
+		// workers wait on tasks that are still queued behind them, more workers get those going
+		if (snapshot.blockedCount > 0 && snapshot.queueDepth > 0)
 		{
-			ThreadPool::Init(m_ThreadCount);
+			return { std::min(MaxThreadCount, workerCount + int(snapshot.blockedCount)),
+				"Workers are blocked waiting on queued tasks" };
 		}
 
+		// everyone is busy and the queue keeps growing, that's CPU bound so one per core is the most that helps
+		if (runningCount >= snapshot.workerCount && snapshot.queueDepth > snapshot.workerCount && workerCount < hardwareThreads)
+		{
+			return { std::min(MaxThreadCount, hardwareThreads), "Every worker is busy and work is queueing up" };
+		}
+
+		// more workers than cores and none of them waiting, the extra ones only add switching
+		if (snapshot.blockedCount == 0 && snapshot.queueDepth > 0 && workerCount > hardwareThreads)
+		{
+			return { hardwareThreads, "More workers than cores and none of them are blocked" };
+		}
+
+		return {};
+	}
+}
+
+void MenuBar::Draw()
+{
+
+	if (ImGui::Button("Refresh"))
+	{
 		m_RefreshTask->Execute();
 		m_RefButtonPressed = true;
 	}
@@ -35,7 +74,7 @@ void MenuBar::Draw()
 		// Render the merge confirmation box
 		if (m_MergeButtonPressed)
 		{
-			if (m_MergeTask->IsARCToolExist() && m_MergeTask->IsFinished() && m_RefButtonPressed)
+			if (m_MergeTask->IsARCToolExist() && m_MergeTask->IsFinished() && m_RefButtonPressed && m_MergeTask->IsContentReady())
 			{
 				ImGui::OpenPopup("Merge Confirmation");
 			}
@@ -54,6 +93,10 @@ void MenuBar::Draw()
 				{
 					ImGui::Text("Merge operation is already started");
 				}
+				else if (m_RefButtonPressed && !m_MergeTask->IsContentReady())
+				{
+					ImGui::Text("Mods are still loading");
+				}
 
 				if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) ||
 					ImGui::IsMouseClicked(ImGuiMouseButton_Right))
@@ -77,8 +120,6 @@ void MenuBar::Draw()
 				if (ImGui::Button("Yes", ImVec2(120.0f, 0.0f)))
 				{
 
-					ThreadPool::Init(m_ThreadCount);
-
 					m_MergeTask->Execute();
 					m_MergeButtonPressed = false;
 				}
@@ -94,6 +135,21 @@ void MenuBar::Draw()
 		}
 	}
 
+	// Cancel only shows up while there's something to cancel
+	if (!m_MergeTask->IsFinished())
+	{
+		ImGui::SameLine();
+
+		if (m_MergeTask->IsCancelling())
+		{
+			ImGui::TextDisabled("Cancelling...");
+		}
+		else if (ImGui::Button("Cancel"))
+		{
+			m_MergeTask->Cancel();
+		}
+	}
+
 	ImGui::SameLine(); // Align the next item to the right of the previous item
 
 	// Inside the ImGui window
@@ -115,20 +171,84 @@ void MenuBar::Draw()
 			threadCount = newThreadCount;
 		}
 
-		if (threadCount > 48)
+		if (threadCount > MaxThreadCount)
 		{
-			threadCount = 48;
-			newThreadCount = 48;
+			threadCount = MaxThreadCount;
+			newThreadCount = MaxThreadCount;
 		}
 		else if (threadCount < 1)
 		{
 			threadCount = 1;
 			newThreadCount = 1;
 		}
+
+		// a merge parks workers on its unpack barriers, taking them away could leave a barrier short forever
+		m_PendingThreadCount = threadCount;
+	}
+
+	// keep the last suggestion around, the pool changes every frame while merging
+	if (const auto suggestion{ SuggestThreadCount(ThreadPool::GetMetrics()) }; suggestion.threadCount > 0)
+	{
+		m_SuggestedThreadCount = suggestion.threadCount;
+		m_SuggestionReason = suggestion.reason;
+	}
+
+	if (m_SuggestedThreadCount > 0 && m_SuggestedThreadCount != threadCount)
+	{
+		ImGui::SameLine();
+
+		const std::string suggestionLabel{ "Use " + std::to_string(m_SuggestedThreadCount) };
+		if (ImGui::SmallButton(suggestionLabel.c_str()))
+		{
+			threadCount = m_SuggestedThreadCount;
+			newThreadCount = m_SuggestedThreadCount;
+			m_SuggestedThreadCount = 0;
+
+			m_PendingThreadCount = threadCount;
+		}
+		else if (ImGui::IsItemHovered())
+		{
+			ImGui::SetTooltip("%s", m_SuggestionReason);
+		}
+	}
+
+	if (m_PendingThreadCount > 0)
+	{
+		if (m_MergeTask->IsFinished())
+		{
+			ThreadPool::Init(uint32_t(m_PendingThreadCount));
+			m_PendingThreadCount = 0;
+		}
+		else
+		{
+			ImGui::SameLine();
+			ImGui::TextDisabled("(after the merge)");
+		}
 	}
 
 	ImGui::SameLine();
 
+	if (auto modMerger = m_MergeTask->GetInProcessMerger())
+	{
+		constexpr const char* profileNames[]{ "Store", "Fast", "Default", "Max" };
+		int profile{ int(modMerger->GetCompressionProfile()) };
+
+		ImGui::SetNextItemWidth(80.0f);
+		if (ImGui::Combo("Compression", &profile, profileNames, IM_ARRAYSIZE(profileNames)))
+		{
+			modMerger->SetCompressionProfile(CompressionProfile(profile));
+		}
+
+		ImGui::SameLine();
+	}
+
+	if (!m_MergeTask->IsBackupFinished())
+	{
+		FrameScheduler::RequestFrameWithin(0.25);
+		ImGui::ProgressBar(m_MergeTask->GetBackupProgress(), ImVec2(100.0f, 0.0f), "Backup");
+		ImGui::SameLine();
+	}
+
 	// TODO: display mods that is inside mods folder
 	ImGui::Checkbox("Show Non-Overwrite mods", &m_ShowNonOverwriteMods);
 
@@ -147,9 +267,10 @@ void MenuBar::Draw()
 
 		}
 
-		if(ImGui::MenuItem("Copy backup file to game folder"))
+		// a backup that's still being written would go into the game folder cut off
+		if(ImGui::MenuItem("Copy backup file to game folder", nullptr, false, m_MergeTask->IsFinished() && m_MergeTask->IsBackupFinished()))
 		{
-			
+			m_RestoreBackupTask->Execute();
 		}
 
 		if(ImGui::MenuItem("Copy all mod files to game folder"))
@@ -177,9 +298,74 @@ void RefreshTask::Execute()
 
 bool MergeTask::IsARCToolExist() const
 {
+	// ARCTool isn't needed when the merge unpacks and repacks in process
+	if (auto modMerger = m_ModMerger.lock(); modMerger && modMerger->HasEntryCodec())
+	{
+		return true;
+	}
+
 	return std::filesystem::exists(m_ARCToolPath);
 }
 
+bool MergeTask::IsBackupFinished() const
+{
+	if (auto fileCloneUtility = m_CloneUtility.lock())
+	{
+		return fileCloneUtility->IsBackupFinished();
+	}
+
+	return true;
+}
+
+float MergeTask::GetBackupProgress() const
+{
+	if (auto fileCloneUtility = m_CloneUtility.lock())
+	{
+		const auto progress{ fileCloneUtility->GetBackupProgress() };
+		return progress.total > 0 ? float(progress.finished) / float(progress.total) : 1.0f;
+	}
+
+	return 1.0f;
+}
+
+std::shared_ptr<ModMerger> MergeTask::GetInProcessMerger() const
+{
+	if (auto modMerger = m_ModMerger.lock(); modMerger && modMerger->HasEntryCodec())
+	{
+		return modMerger;
+	}
+
+	return nullptr;
+}
+
+void MergeTask::Cancel()
+{
+	if (auto modMerger = m_ModMerger.lock())
+	{
+		modMerger->CancelMerge();
+	}
+}
+
+bool MergeTask::IsCancelling() const
+{
+	if (auto modMerger = m_ModMerger.lock())
+	{
+		return modMerger->IsCancelling();
+	}
+
+	return false;
+}
+
+bool MergeTask::IsContentReady() const
+{
+	if (auto mergeArea = m_MergeArea.lock())
+	{
+		return mergeArea->IsContentReady();
+	}
+
+	return false;
+}
+
 bool MergeTask::IsFinished() const
 {
 	if (auto modMerger = m_ModMerger.lock())
@@ -203,16 +389,24 @@ void MergeTask::Execute()
 		const auto& userOverwriteOrder{ mergeArea->GetUserModsOverwriteOrder() };
 		const auto& dirTree{ dirTreeCreator->GetDirTree() };
 
+		powe::details::BackupFutures backupFutures{};
+
 		if (fileCloneUtility)
 		{
-			for (const auto& [fileName, paths] : userOverwriteOrder)
-			{
-				fileCloneUtility->BackupMainFile(dirTree, paths);
-			}
+			backupFutures = fileCloneUtility->BackupMainFileAsync(dirTree, userOverwriteOrder);
 		}
 
 		modMerger->MergeContentAsync(
-			dirTreeCreator->GetDirTree(),
-			mergeArea->GetUserModsOverwriteOrder(), true);
+			dirTree,
+			userOverwriteOrder,
+			std::move(backupFutures), true);
+	}
+}
+
+void RestoreBackupTask::Execute()
+{
+	if (auto fileCloneUtility = m_CloneUtility.lock())
+	{
+		fileCloneUtility->RestoreAllAsync();
 	}
 }
@@ -55,6 +55,18 @@ public:
 	bool IsARCToolExist() const;
 	bool IsFinished() const;
 
+	// Every mod is scanned, not just the partial list that shows up while they load
+	bool IsContentReady() const;
+	bool IsBackupFinished() const;
+
+	// Stop the running merge, what's already merged stays
+	void Cancel();
+	bool IsCancelling() const;
+	float GetBackupProgress() const;
+
+	// nullptr when the merge goes through ARCTool and the profile doesn't apply
+	std::shared_ptr<ModMerger> GetInProcessMerger() const;
+
 	virtual void Execute();
 
 	~MergeTask() = default;
@@ -68,15 +80,36 @@ private:
 	std::string m_ARCToolPath;
 };
 
+class RestoreBackupTask : public Command
+{
+public:
+
+	explicit RestoreBackupTask(
+		const std::shared_ptr<FileCloneUtility>& cloneUtility)
+		: m_CloneUtility(cloneUtility)
+	{
+	}
+
+	virtual void Execute();
+
+	~RestoreBackupTask() = default;
+
+private:
+
+	std::weak_ptr<FileCloneUtility> m_CloneUtility;
+};
+
 
 class MenuBar : public Widget
 {
 public:
 
 	MenuBar(std::unique_ptr<RefreshTask>&& refreshTask,
-			std::unique_ptr<MergeTask>&& mergeTask)
+			std::unique_ptr<MergeTask>&& mergeTask,
+			std::unique_ptr<RestoreBackupTask>&& restoreBackupTask)
 		: m_RefreshTask(std::move(refreshTask))
 		, m_MergeTask(std::move(mergeTask))
+		, m_RestoreBackupTask(std::move(restoreBackupTask))
 	{
 	}
 
@@ -87,10 +120,18 @@ private:
 
 	std::unique_ptr<RefreshTask> m_RefreshTask;
 	std::unique_ptr<MergeTask> m_MergeTask;
+	std::unique_ptr<RestoreBackupTask> m_RestoreBackupTask;
 
 	int m_ThreadCount{ int(std::thread::hardware_concurrency()) };
 	int m_NewThreadCount{  int(std::thread::hardware_concurrency()) };
 
+	// the pool is only resized while no merge runs, 0 when there's nothing to apply
+	int m_PendingThreadCount{};
+
+	// from the main pool's metrics, 0 when there's nothing to suggest
+	int m_SuggestedThreadCount{};
+	const char* m_SuggestionReason{};
+
 	bool m_MergeButtonPressed{};
 	bool m_RefButtonPressed{};
 	bool m_ShowNonOverwriteMods{};
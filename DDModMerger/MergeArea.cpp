@@ -1,13 +1,16 @@
 #include "MergeArea.h"
 
+#include <algorithm>
 #include <execution>
 
 #include "DirTreeCreator.h"
 #include "ContentManager.h"
 #include "ModMerger.h"
+#include "ConflictAnalyzer.h"
 
 #include "imgui.h"
 #include "EnvironmentVariables.h"
+#include "FrameScheduler.h"
 
 namespace fs = std::filesystem;
 
@@ -15,6 +18,12 @@ void MergeArea::SetMergeAreaVisible(bool visible)
 {
 	m_MergeAreaVisible = visible;
 	m_RefreshModsContent = false;
+	m_PartialModsOverwriteOrder.reset();
+	m_DirTreeTemp = nullptr;
+
+	// the first partial results of the new scan won't have it yet
+	m_SelectedMainFileName.clear();
+	m_SelectedModFileIndex = -1;
 }
 
 void MergeArea::Draw()
@@ -31,6 +40,29 @@ void MergeArea::Draw()
 		if (!modMerger || !dirTreeCreator || !contentManager)
 			return;
 
+		// once a merge went through, what it rebuilt doesn't need rebuilding anymore
+		const bool merging{ !modMerger->IsReadyToMerge() };
+		if (merging && !m_Merging)
+		{
+			m_MergingArchives = m_ChangedArchives;
+			m_MergeCancelled = false;
+		}
+		else if (!merging && m_Merging && !m_MergeCancelled)
+		{
+			// one that failed is still changed, it has to merge again even when its mods don't change
+			const auto unmergedArchives{ modMerger->GetUnmergedArchives() };
+			std::erase_if(m_MergingArchives, [&unmergedArchives](const std::string& archiveName)
+				{
+					return unmergedArchives.contains(archiveName);
+				});
+
+			contentManager->SetArchivesMerged(m_MergingArchives);
+			m_ChangedArchives = contentManager->GetChangedArchives();
+		}
+
+		m_MergeCancelled = m_MergeCancelled || (merging && modMerger->IsCancelling());
+		m_Merging = merging;
+
 		ImGui::Dummy(ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing()));
 
 		ImGui::Text("Overwrite ARC Files");
@@ -39,40 +71,97 @@ void MergeArea::Draw()
 		{
 			ImGui::SameLine(0.0f, 10.0f);
 
-			// Add animation here
+			// Add animation here, it's the only thing that keeps the UI drawing during a merge
+			FrameScheduler::RequestFrameWithin(1.0 / FrameScheduler::MaxAnimationRate);
+
 			static float time = 0.0f;
 			time += ImGui::GetIO().DeltaTime;
 			float alpha = (sinf(time * 2.0f) + 1.0f) * 0.5f;
 			ImVec4 textColor = ImVec4(1.0f, 1.0f, 1.0f, alpha);
-			ImGui::TextColored(textColor, "Merging...");
+			ImGui::TextColored(textColor, modMerger->IsCancelling() ? "Cancelling..." : "Merging...");
+
+			const auto usage{ modMerger->GetMergeUsage() };
+			if (usage.activeTasks > 0)
+			{
+				constexpr float bytesToGB{ 1.0f / float(1 << 30) };
+
+				ImGui::SameLine(0.0f, 10.0f);
+				ImGui::TextDisabled("%u running | RAM %.1f/%.1f GB | Staging %.1f/%.1f GB",
+					usage.activeTasks,
+					float(usage.inFlight.memoryBytes) * bytesToGB, float(usage.limit.memoryBytes) * bytesToGB,
+					float(usage.inFlight.diskBytes) * bytesToGB, float(usage.limit.diskBytes) * bytesToGB);
+			}
 		}
 
 		if (!m_RefreshModsContent)
 		{
-			if (!contentManager->IsFinished())
-				return;
-			else
+			if (!m_DirTreeTemp && dirTreeCreator->IsFinished())
 			{
-				m_ModsOverwriteOrderTemp = contentManager->GetAllModsOverwriteOrder();
+				m_DirTreeTemp = &dirTreeCreator->GetDirTree();
 			}
 
-			if (!dirTreeCreator->IsFinished())
-				return;
+			if (!contentManager->IsFinished() || !m_DirTreeTemp)
+			{
+				// show what's been scanned so far, big mod folders take a while
+				if (auto partial = contentManager->GetPartialModsOverwriteOrder(); partial && partial != m_PartialModsOverwriteOrder)
+				{
+					m_PartialModsOverwriteOrder = std::move(partial);
+					m_ModsOverwriteOrderTemp = *m_PartialModsOverwriteOrder;
+					SortsOverwriteFileName(m_ModsOverwriteOrderTemp);
+				}
+
+				if (!m_PartialModsOverwriteOrder)
+					return;
+
+				const auto progress{ contentManager->GetScanProgress() };
+				ImGui::SameLine(0.0f, 10.0f);
+				ImGui::TextDisabled("Scanning mods %u/%u", progress.scannedModCount, progress.modCount);
+			}
 			else
 			{
-				m_DirTreeTemp = &dirTreeCreator->GetDirTree();
+				m_ModsOverwriteOrderTemp = contentManager->GetAllModsOverwriteOrder();
+				m_PartialModsOverwriteOrder.reset();
 			}
+		}
 
+		if (!m_RefreshModsContent && !m_PartialModsOverwriteOrder)
+		{
 			SortsOverwriteFileName(m_ModsOverwriteOrderTemp);
+			m_SearchIndex.BuildAsync(*m_DirTreeTemp, m_ModsOverwriteOrderTemp,
+				dirTreeCreator->GetSearchFolderPath(), contentManager->GetModsFilePath());
+
+			if (auto conflictAnalyzer = m_ConflictAnalyzer.lock())
+			{
+				conflictAnalyzer->AnalyzeAsync(*m_DirTreeTemp, m_ModsOverwriteOrderTemp);
+			}
 
+			m_ChangedArchives = contentManager->GetChangedArchives();
 			m_RefreshModsContent = true;
 		}
 
+		// the watchers' changes go in between merges, a running merge reads these lists
+		if (m_RefreshModsContent && modMerger->IsReadyToMerge())
+		{
+			const bool dirTreeChanged{ dirTreeCreator->ApplyWatchedChanges() };
+			const bool modsChanged{ contentManager->ApplyWatchedChanges() };
+
+			if (dirTreeChanged || modsChanged)
+				ReloadWatchedContent(*contentManager, *dirTreeCreator);
+		}
+
+		if (m_RefreshModsContent && !m_ChangedArchives.empty())
+		{
+			ImGui::SameLine(0.0f, 10.0f);
+			ImGui::TextDisabled("%d changed since the last merge", int(m_ChangedArchives.size()));
+		}
+
 		auto& modsOverwriteOrder{ m_ModsOverwriteOrderTemp };
 
-		ImGui::Dummy(ImVec2(0.0f, ImGui::GetFrameHeight()));
+		ImGui::SetNextItemWidth(m_WindowContext.width * 0.4f);
+		ImGui::InputTextWithHint("##Search", "Search archives, paths and mods", m_SearchText.data(), m_SearchText.size());
 
-		if (m_SelectedModFileIndex >= 0)
+		// the order can only be changed once every mod is in, a partial list gets replaced
+		if (m_SelectedModFileIndex >= 0 && m_RefreshModsContent)
 		{
 			ImGui::SameLine(m_WindowContext.width * 0.5f);
 			auto& modsOrder{ modsOverwriteOrder.at(m_SelectedMainFileName) };
@@ -81,6 +170,7 @@ void MergeArea::Draw()
 			{
 				std::swap(modsOrder[m_SelectedModFileIndex], modsOrder[m_SelectedModFileIndex - 1]);
 				m_SelectedModFileIndex--;
+				InvalidateModDisplayNames();
 			}
 
 			ImGui::SameLine(0.0f, 10.0f);
@@ -89,6 +179,7 @@ void MergeArea::Draw()
 			{
 				std::swap(modsOrder[m_SelectedModFileIndex], modsOrder[m_SelectedModFileIndex + 1]);
 				m_SelectedModFileIndex++;
+				InvalidateModDisplayNames();
 			}
 		}
 
@@ -98,17 +189,22 @@ void MergeArea::Draw()
 		{
 			ImGui::PopStyleColor();
 
-			std::vector<std::string> overwriteFileNames;
+			// points into m_OverwriteCountList, nothing gets copied
+			const std::vector<std::string>* overwriteFileNames{};
 
-			if (ImGui::BeginTabBar("##ModsCountBar",
+			if (m_SearchText.front() != '\0')
+			{
+				DrawSearchResults();
+			}
+			else if (ImGui::BeginTabBar("##ModsCountBar",
 				ImGuiTabBarFlags_FittingPolicyResizeDown | ImGuiTabBarFlags_FittingPolicyScroll))
 			{
 
-				for (const auto& [count, fileNames] : m_OverwriteCountList)
+				for (const auto& [count, overwriteGroup] : m_OverwriteCountList)
 				{
-					if (ImGui::BeginTabItem(std::to_string(count).c_str()))
+					if (ImGui::BeginTabItem(overwriteGroup.tabLabel.c_str()))
 					{
-						overwriteFileNames = fileNames;
+						overwriteFileNames = &overwriteGroup.fileNames;
 						ImGui::EndTabItem();
 					}
 				}
@@ -116,41 +212,66 @@ void MergeArea::Draw()
 				ImGui::EndTabBar();
 			}
 
-			// TODO: Do all the list of selectables files here
-			for (const auto& fileName : overwriteFileNames)
+			if (overwriteFileNames)
 			{
-
-				if (ImGui::Selectable(fileName.c_str(), m_SelectedMainFileName == fileName))
+				// only the rows that are on screen get submitted
+				ImGuiListClipper clipper;
+				clipper.Begin(int(overwriteFileNames->size()));
+				while (clipper.Step())
 				{
-					if (m_SelectedMainFileName == fileName)
+					for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
 					{
-						m_SelectedMainFileName.clear();
-						m_SelectedModFileIndex = -1;
-					}
-					else
-					{
-						m_SelectedMainFileName = fileName;
-						m_SelectedModFileIndex = -1;
-					}
-				}
+						const std::string& fileName{ (*overwriteFileNames)[i] };
 
-				if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal | ImGuiHoveredFlags_NoSharedDelay))
-				{
-					ImGui::SetTooltip(m_DirTreeTemp->at(fileName).c_str());
-				}
+						if (ImGui::Selectable(fileName.c_str(), m_SelectedMainFileName == fileName))
+						{
+							if (m_SelectedMainFileName == fileName)
+							{
+								m_SelectedMainFileName.clear();
+								m_SelectedModFileIndex = -1;
+							}
+							else
+							{
+								m_SelectedMainFileName = fileName;
+								m_SelectedModFileIndex = -1;
+							}
+
+							InvalidateModDisplayNames();
+						}
 
-				if (ImGui::IsItemClicked(ImGuiMouseButton_Right))
-				{
-					ImGui::OpenPopup("##MainFilesPopupMenu");
-					m_PopupFileName = fileName;
+						const bool hovered{ ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal | ImGuiHoveredFlags_NoSharedDelay) };
+						const bool rightClicked{ ImGui::IsItemClicked(ImGuiMouseButton_Right) };
+
+						if (m_ChangedArchives.contains(fileName))
+						{
+							ImGui::SameLine();
+							ImGui::TextDisabled("changed");
+						}
+
+						if (hovered && m_DirTreeTemp)
+						{
+							// a mod can bring a file the game doesn't have
+							if (const auto itr = m_DirTreeTemp->find(fileName); itr != m_DirTreeTemp->end())
+								ImGui::SetTooltip("%s", itr->second.c_str());
+						}
+
+						if (rightClicked)
+						{
+							ImGui::OpenPopup("##MainFilesPopupMenu");
+							m_PopupFileName = fileName;
+						}
+					}
 				}
 			}
 
 			if (ImGui::BeginPopup("##MainFilesPopupMenu"))
 			{
-				if (ImGui::MenuItem("Open in Explorer"))
+				const auto itr{ m_DirTreeTemp ? m_DirTreeTemp->find(m_PopupFileName) : powe::details::DirectoryTree::const_iterator{} };
+				const bool hasPath{ m_DirTreeTemp && itr != m_DirTreeTemp->end() };
+
+				if (ImGui::MenuItem("Open in Explorer", nullptr, false, hasPath))
 				{
-					const fs::path path{ m_DirTreeTemp->at(m_PopupFileName) };
+					const fs::path path{ itr->second };
 					const std::string command{ "explorer " + fs::absolute(path.parent_path()).string() };
 					system(command.c_str());
 				}
@@ -166,42 +287,53 @@ void MergeArea::Draw()
 		ImGui::SameLine(0.0f, 50.0f);
 		if (ImGui::BeginChild("##ModFiles1", ImVec2(-1.0f, ImGui::GetTextLineHeightWithSpacing() * 8), ImGuiChildFlags_Border | ImGuiChildFlags_ResizeY))
 		{
+			const auto selectedItr{ modsOverwriteOrder.find(m_SelectedMainFileName) };
 			if (m_SelectedMainFileName.empty())
 			{
 				ImGui::Text("Select a file to view its mods");
 			}
+			else if (selectedItr == modsOverwriteOrder.end())
+			{
+				// partial results, the mods that overwrite it weren't scanned yet
+				ImGui::TextDisabled("Scanning...");
+			}
 			else
 			{
-				const auto& modsOrder{ modsOverwriteOrder.at(m_SelectedMainFileName) };
+				const auto& modsOrder{ selectedItr->second };
 
-				for (size_t i = 0; i < modsOrder.size(); i++)
+				if (m_ModDisplayNamesDirty)
 				{
-					std::string modsName{ modsOrder[i] };
-					modsName = modsName.substr(contentManager->GetModsFilePath().size() + 1); // + 1 for the '/'
-					modsName = modsName.substr(0, modsName.find_first_of("/\\"));
-					modsName = std::to_string(i) + "\t" + modsName;
+					RebuildModDisplayNames(modsOrder, contentManager->GetModsFilePath());
+				}
 
-					if (ImGui::Selectable(modsName.c_str(), m_SelectedModFileIndex == i))
+				ImGuiListClipper clipper;
+				clipper.Begin(int(m_ModDisplayNames.size()));
+				while (clipper.Step())
+				{
+					for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
 					{
-						if (m_SelectedModFileIndex == i)
-						{
-							m_SelectedModFileIndex = -1;
-						}
-						else
+						if (ImGui::Selectable(m_ModDisplayNames[i].c_str(), m_SelectedModFileIndex == i))
 						{
-							m_SelectedModFileIndex = int(i);
+							if (m_SelectedModFileIndex == i)
+							{
+								m_SelectedModFileIndex = -1;
+							}
+							else
+							{
+								m_SelectedModFileIndex = i;
+							}
 						}
-					}
 
 #ifdef _WIN32
-					if (ImGui::IsItemClicked(ImGuiMouseButton_Right))
-					{
-						ImGui::OpenPopup("##MainFilesPopupMenu");
-						m_PopupFileName = modsOrder[i];
-					}
+						if (ImGui::IsItemClicked(ImGuiMouseButton_Right))
+						{
+							ImGui::OpenPopup("##MainFilesPopupMenu");
+							m_PopupFileName = modsOrder[i];
+						}
 #endif
 
-					ImGui::Spacing();
+						ImGui::Spacing();
+					}
 				}
 
 #ifdef _WIN32
@@ -217,6 +349,10 @@ void MergeArea::Draw()
 					ImGui::EndPopup();
 				}
 #endif
+
+				// the entries are only compared once the list is final
+				if (m_RefreshModsContent)
+					DrawEntryConflicts(modsOrder, contentManager->GetModsFilePath());
 			}
 
 			ImGui::EndChild();
@@ -228,12 +364,203 @@ void MergeArea::Draw()
 
 void MergeArea::SortsOverwriteFileName(const powe::details::ModsOverwriteOrder& modsOverwriteOrder)
 {
+	// a refresh starts over, otherwise every file shows up once more per refresh
+	m_OverwriteCountList.clear();
+	InvalidateModDisplayNames();
+
 	for (const auto& [fileName, path] : modsOverwriteOrder)
 	{
-		std::vector<std::string> modFiles;
-		m_OverwriteCountList[int(path.size())].emplace_back(fileName);
+		m_OverwriteCountList[int(path.size())].fileNames.emplace_back(fileName);
+	}
+
+	for (auto& [count, overwriteGroup] : m_OverwriteCountList)
+	{
+		overwriteGroup.tabLabel = std::to_string(count);
 	}
 }
 
+void MergeArea::ReloadWatchedContent(ContentManager& contentManager, DirTreeCreator& dirTreeCreator)
+{
+	powe::details::ModsOverwriteOrder modsOverwriteOrder{};
+	modsOverwriteOrder.reserve(contentManager.GetAllModsOverwriteOrder().size());
+
+	for (const auto& [fileName, modsOrder] : contentManager.GetAllModsOverwriteOrder())
+	{
+		auto userItr{ m_ModsOverwriteOrderTemp.find(fileName) };
+		if (userItr != m_ModsOverwriteOrderTemp.end() &&
+			std::is_permutation(userItr->second.begin(), userItr->second.end(), modsOrder.begin(), modsOrder.end()))
+		{
+			modsOverwriteOrder.emplace(fileName, std::move(userItr->second));
+			continue;
+		}
+
+		if (fileName == m_SelectedMainFileName)
+			m_SelectedModFileIndex = -1;
+
+		modsOverwriteOrder.emplace(fileName, modsOrder);
+	}
+
+	m_ModsOverwriteOrderTemp = std::move(modsOverwriteOrder);
+	m_ChangedArchives = contentManager.GetChangedArchives();
+
+	if (!m_ModsOverwriteOrderTemp.contains(m_SelectedMainFileName))
+	{
+		m_SelectedMainFileName.clear();
+		m_SelectedModFileIndex = -1;
+	}
+
+	SortsOverwriteFileName(m_ModsOverwriteOrderTemp);
+	m_SearchIndex.BuildAsync(*m_DirTreeTemp, m_ModsOverwriteOrderTemp,
+		dirTreeCreator.GetSearchFolderPath(), contentManager.GetModsFilePath());
+
+	// reports of the files whose mods didn't change are still cached
+	if (auto conflictAnalyzer = m_ConflictAnalyzer.lock())
+	{
+		conflictAnalyzer->AnalyzeAsync(*m_DirTreeTemp, m_ModsOverwriteOrderTemp);
+	}
+}
+
+void MergeArea::DrawSearchResults()
+{
+	constexpr size_t MaxSearchResults{ 1000 };
+
+	// only query again when the text or the index changed, typing costs one query per key
+	const std::string_view searchText{ m_SearchText.data() };
+	auto snapshot{ m_SearchIndex.GetSnapshot() };
+	if (searchText != m_SearchQuery || snapshot != m_SearchSnapshot)
+	{
+		m_SearchQuery = searchText;
+		m_SearchSnapshot = std::move(snapshot);
+		m_SearchResults = m_SearchSnapshot ? m_SearchSnapshot->Query(m_SearchQuery, MaxSearchResults) : std::vector<SearchIndex::Result>{};
+	}
+
+	if (!m_SearchSnapshot)
+	{
+		ImGui::TextDisabled("Indexing...");
+		return;
+	}
+
+	ImGui::TextDisabled(m_SearchResults.size() >= MaxSearchResults ? "%d+ results" : "%d results", int(m_SearchResults.size()));
+
+	ImGuiListClipper clipper;
+	clipper.Begin(int(m_SearchResults.size()));
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+		{
+			const auto& result{ m_SearchResults[i] };
+			const std::string& fileName{ *result.fileName };
+
+			// only what a mod overwrites can be picked, the rest is there to show it was found
+			if (result.modCount == 0 || !m_ModsOverwriteOrderTemp.contains(fileName))
+			{
+				ImGui::TextDisabled("%s", fileName.c_str());
+			}
+			else if (ImGui::Selectable(fileName.c_str(), m_SelectedMainFileName == fileName))
+			{
+				m_SelectedMainFileName = fileName;
+				m_SelectedModFileIndex = -1;
+				InvalidateModDisplayNames();
+			}
+
+			if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal | ImGuiHoveredFlags_NoSharedDelay))
+			{
+				ImGui::SetTooltip("%s\n%u mods%s", result.relativePath->c_str(), result.modCount, result.exact ? "" : " (close match)");
+			}
+		}
+	}
+}
+
+void MergeArea::InvalidateModDisplayNames()
+{
+	m_ModDisplayNamesDirty = true;
+	m_ConflictTooltipIndex = -1;
+}
+
+void MergeArea::RebuildModDisplayNames(const std::vector<std::string>& modsOrder, std::string_view modsFolderPath)
+{
+	m_ModDisplayNames.clear();
+	m_ModDisplayNames.reserve(modsOrder.size());
+
+	for (size_t i = 0; i < modsOrder.size(); i++)
+	{
+		m_ModDisplayNames.emplace_back(std::to_string(i) + "\t" + GetModName(modsFolderPath, modsOrder[i]));
+	}
+
+	m_ModDisplayNamesDirty = false;
+}
+
+void MergeArea::DrawEntryConflicts(const std::vector<std::string>& modsOrder, std::string_view modsFolderPath)
+{
+	auto conflictAnalyzer = m_ConflictAnalyzer.lock();
+	if (!conflictAnalyzer)
+		return;
+
+	ImGui::Separator();
+
+	const auto report{ conflictAnalyzer->GetReport(m_SelectedMainFileName) };
+	if (!report)
+	{
+		ImGui::TextDisabled("Analyzing entries...");
+		return;
+	}
+
+	if (report->failed)
+	{
+		ImGui::TextDisabled("Some archives couldn't be read");
+	}
 
+	ImGui::Text("Changed entries: %d  Collisions: %d", int(report->entries.size()), int(report->conflictCount));
 
+	if (report->conflictCount == 0 || !ImGui::CollapsingHeader("Entry collisions"))
+		return;
+
+	// collisions are sorted to the front of the entries
+	ImGuiListClipper clipper;
+	clipper.Begin(int(report->conflictCount));
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+		{
+			const auto& entry{ report->entries[i] };
+			ImGui::TextUnformatted(entry.entryName.c_str());
+
+			if (!ImGui::IsItemHovered())
+				continue;
+
+			// built once per hovered entry, not every frame it stays hovered
+			if (m_ConflictTooltipIndex == i && m_ConflictTooltipReport == report.get())
+			{
+				ImGui::SetTooltip("%s", m_ConflictTooltip.c_str());
+				continue;
+			}
+
+			// the mod that comes last in the current order wins, same as the merge
+			std::string tooltip{ entry.inMainFile ? "Overwrites main file entry\n" : "New entry\n" };
+			size_t winnerOrder{};
+			std::string winnerName{};
+
+			for (const uint32_t modIndex : entry.modIndices)
+			{
+				const std::string& modPath{ report->modPaths[modIndex] };
+				const std::string modName{ GetModName(modsFolderPath, modPath) };
+				tooltip += modName + '\n';
+
+				const auto orderItr = std::find(modsOrder.begin(), modsOrder.end(), modPath);
+				const size_t order{ size_t(std::distance(modsOrder.begin(), orderItr)) };
+				if (orderItr != modsOrder.end() && order >= winnerOrder)
+				{
+					winnerOrder = order;
+					winnerName = modName;
+				}
+			}
+
+			tooltip += "Winner: " + winnerName;
+			ImGui::SetTooltip("%s", tooltip.c_str());
+
+			m_ConflictTooltip = std::move(tooltip);
+			m_ConflictTooltipReport = report.get();
+			m_ConflictTooltipIndex = i;
+		}
+	}
+}
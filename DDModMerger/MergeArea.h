@@ -2,12 +2,16 @@
 #include "Widget.h"
 
 #include "Types.h"
+#include "SearchIndex.h"
 
+#include <array>
 #include <map>
+#include <unordered_set>
 
 class ContentManager;
 class DirTreeCreator;
 class ModMerger;
+class ConflictAnalyzer;
 class MergeArea : public Widget
 {
 public:
@@ -15,10 +19,12 @@ public:
 	MergeArea(
 		const std::shared_ptr<ContentManager>& contentManager,
 		const std::shared_ptr<DirTreeCreator>& dirTreeCreator,
-		const std::shared_ptr<ModMerger>& modMerger)
+		const std::shared_ptr<ModMerger>& modMerger,
+		const std::shared_ptr<ConflictAnalyzer>& conflictAnalyzer)
 		: m_ContentManager(contentManager)
 		, m_DirTreeCreator(dirTreeCreator)
 		, m_ModMerger(modMerger)
+		, m_ConflictAnalyzer(conflictAnalyzer)
 	{
 	}
 
@@ -29,21 +35,65 @@ public:
 		return m_ModsOverwriteOrderTemp;
 	}
 
+	// False while the list is still a partial one from a running scan
+	bool IsContentReady() const { return m_RefreshModsContent; }
+
 	void Draw() override;
 	~MergeArea() = default;
 
 private:
 
 	void SortsOverwriteFileName(const powe::details::ModsOverwriteOrder& modsOverwriteOrder );
+	void DrawEntryConflicts(const std::vector<std::string>& modsOrder, std::string_view modsFolderPath);
+
+	// Takes what the folder watchers changed, the order the user picked stays for every file whose mods are the same
+	void ReloadWatchedContent(ContentManager& contentManager, DirTreeCreator& dirTreeCreator);
+
+	// Replaces the tabs while there's something in the search box
+	void DrawSearchResults();
+
+	// The mods list shows cached strings, this makes the next frame build them again
+	void InvalidateModDisplayNames();
+	void RebuildModDisplayNames(const std::vector<std::string>& modsOrder, std::string_view modsFolderPath);
 
 	std::weak_ptr<ContentManager> m_ContentManager;
 	std::weak_ptr<DirTreeCreator> m_DirTreeCreator;
 	std::weak_ptr<ModMerger> m_ModMerger;
+	std::weak_ptr<ConflictAnalyzer> m_ConflictAnalyzer;
 
 	powe::details::ModsOverwriteOrder m_ModsOverwriteOrderTemp{};
 	const powe::details::DirectoryTree* m_DirTreeTemp{};
 
-	std::map<int, std::vector<std::string>,std::greater<int>> m_OverwriteCountList{};
+	// the last partial result shown, so the lists are only rebuilt when the scan publishes a new one
+	std::shared_ptr<const powe::details::ModsOverwriteOrder> m_PartialModsOverwriteOrder{};
+
+	struct OverwriteGroup
+	{
+		std::string tabLabel;
+		std::vector<std::string> fileNames;
+	};
+
+	std::map<int, OverwriteGroup, std::greater<int>> m_OverwriteCountList{};
+
+	// Everything the lists draw is built once when it changes, not every frame
+	std::vector<std::string> m_ModDisplayNames{};
+	bool m_ModDisplayNamesDirty{ true };
+
+	SearchIndex m_SearchIndex{};
+	std::array<char, 128> m_SearchText{};
+	std::string m_SearchQuery{}; // what m_SearchResults are for
+	std::shared_ptr<const SearchIndex::Snapshot> m_SearchSnapshot{}; // keeps the strings of the results alive
+	std::vector<SearchIndex::Result> m_SearchResults{};
+
+	// archives whose mods changed since they were last merged, and the ones the running merge rebuilds
+	std::unordered_set<std::string> m_ChangedArchives{};
+	std::unordered_set<std::string> m_MergingArchives{};
+	bool m_Merging{};
+	bool m_MergeCancelled{};
+
+	std::string m_ConflictTooltip{};
+	const void* m_ConflictTooltipReport{};
+	int m_ConflictTooltipIndex{ -1 };
 
 	std::string m_SelectedMainFileName{};
 	std::string m_PopupFileName{};
@@ -0,0 +1,97 @@
+#include "MergeGovernor.h"
+
+#include <algorithm>
+#include <utility>
+
+MergeGovernor::Ticket::Ticket(MergeGovernor* governor, Cost cost)
+	: m_Governor(governor)
+	, m_Cost(cost)
+{
+}
+
+MergeGovernor::Ticket::Ticket(Ticket&& other) noexcept
+	: m_Governor(std::exchange(other.m_Governor, nullptr))
+	, m_Cost(other.m_Cost)
+{
+}
+
+MergeGovernor::Ticket& MergeGovernor::Ticket::operator=(Ticket&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (m_Governor)
+			m_Governor->Release(m_Cost);
+
+		m_Governor = std::exchange(other.m_Governor, nullptr);
+		m_Cost = other.m_Cost;
+	}
+
+	return *this;
+}
+
+MergeGovernor::Ticket::~Ticket()
+{
+	if (m_Governor)
+		m_Governor->Release(m_Cost);
+}
+
+MergeGovernor::MergeGovernor(Cost limit)
+	: m_Limit(limit)
+{
+}
+
+MergeGovernor::Ticket MergeGovernor::Acquire(Cost cost, std::stop_token stopToken)
+{
+	std::unique_lock lock(m_Mutex);
+	if (!m_ReleaseCV.wait(lock, stopToken, [this, cost] { return Fits(cost); }))
+		return Ticket{};
+
+	m_InFlight.memoryBytes += cost.memoryBytes;
+	m_InFlight.diskBytes += cost.diskBytes;
+	m_InFlight.workerCount += cost.workerCount;
+	m_Peak.memoryBytes = std::max(m_Peak.memoryBytes, m_InFlight.memoryBytes);
+	m_Peak.diskBytes = std::max(m_Peak.diskBytes, m_InFlight.diskBytes);
+	m_ActiveTasks++;
+
+	return Ticket{ this, cost };
+}
+
+void MergeGovernor::SetLimit(Cost limit)
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_Limit = limit;
+	}
+
+	m_ReleaseCV.notify_all();
+}
+
+MergeGovernor::Usage MergeGovernor::GetUsage() const
+{
+	std::scoped_lock lock(m_Mutex);
+	return Usage{ m_InFlight, m_Limit, m_Peak, m_ActiveTasks };
+}
+
+bool MergeGovernor::Fits(Cost cost) const
+{
+	// never starve work that's bigger than the whole budget, let it run alone
+	if (m_ActiveTasks == 0)
+		return true;
+
+	return m_InFlight.memoryBytes + cost.memoryBytes <= m_Limit.memoryBytes &&
+		m_InFlight.diskBytes + cost.diskBytes <= m_Limit.diskBytes &&
+		m_InFlight.workerCount + cost.workerCount <= m_Limit.workerCount;
+}
+
+void MergeGovernor::Release(Cost cost)
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_InFlight.memoryBytes -= cost.memoryBytes;
+		m_InFlight.diskBytes -= cost.diskBytes;
+		m_InFlight.workerCount -= cost.workerCount;
+		m_ActiveTasks--;
+	}
+
+	m_ReleaseCV.notify_all();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+
+/// <summary>
+/// Admits merge work by the bytes it's expected to hold instead of by task count.
+/// Memory, staging disk and pool workers are checked together so a task either gets all of them or waits.
+/// Work bigger than a limit still runs, but only when nothing else is in flight
+/// </summary>
+class MergeGovernor
+{
+public:
+
+	struct Cost
+	{
+		uint64_t memoryBytes{};
+		uint64_t diskBytes{};
+		uint32_t workerCount{}; // main pool workers its unpacks take up at once
+	};
+
+	struct Usage
+	{
+		Cost inFlight;
+		Cost limit;
+		Cost peak;
+		uint32_t activeTasks{};
+	};
+
+	// Gives the cost back when it goes out of scope
+	class Ticket
+	{
+	public:
+
+		Ticket() = default;
+		Ticket(MergeGovernor* governor, Cost cost);
+		Ticket(Ticket&& other) noexcept;
+		Ticket& operator=(Ticket&& other) noexcept;
+		~Ticket();
+
+		Ticket(const Ticket&) = delete;
+		Ticket& operator=(const Ticket&) = delete;
+
+		// false when the wait was cancelled
+		bool IsValid() const { return m_Governor != nullptr; }
+
+	private:
+
+		MergeGovernor* m_Governor{};
+		Cost m_Cost{};
+	};
+
+	explicit MergeGovernor(Cost limit);
+
+	// Blocks until the cost fits, gives back an invalid ticket if stopToken is triggered first
+	[[nodiscard]] Ticket Acquire(Cost cost, std::stop_token stopToken = {});
+
+	void SetLimit(Cost limit);
+	Usage GetUsage() const;
+
+private:
+
+	bool Fits(Cost cost) const;
+	void Release(Cost cost);
+
+	mutable std::mutex m_Mutex;
+	std::condition_variable_any m_ReleaseCV;
+
+	Cost m_InFlight{};
+	Cost m_Limit{};
+	Cost m_Peak{};
+	uint32_t m_ActiveTasks{};
+};
+
@@ -0,0 +1,173 @@
+#include "MergeManifest.h"
+
+#include <fstream>
+#include <unordered_set>
+
+#include "nlohmann/json.hpp"
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+MergeManifest::FileFingerprint CreateFingerprint(std::string_view filePath)
+{
+	std::error_code errorCode{};
+	const fs::path path{ filePath };
+
+	MergeManifest::FileFingerprint fingerprint{ std::string(filePath) };
+	fingerprint.size = fs::file_size(path, errorCode);
+	if (!errorCode)
+		fingerprint.lastWriteTime = int64_t(fs::last_write_time(path, errorCode).time_since_epoch().count());
+
+	return fingerprint;
+}
+
+MergeManifest::MergeManifest(std::string_view manifestFilePath)
+	: m_ManifestFilePath(manifestFilePath)
+{
+}
+
+MergeManifest::Inputs MergeManifest::CreateInputs(std::string_view mainFilePath, const std::vector<std::string>& pathToMods)
+{
+	Inputs inputs{};
+	inputs.reserve(pathToMods.size() + 1);
+
+	inputs.emplace_back(CreateFingerprint(mainFilePath));
+	for (const auto& modPath : pathToMods)
+	{
+		inputs.emplace_back(CreateFingerprint(modPath));
+	}
+
+	return inputs;
+}
+
+bool MergeManifest::IsUpToDate(const std::string& outputFilePath, const Inputs& inputs, std::string_view options) const
+{
+	std::scoped_lock lock(m_RecordsMutex);
+
+	const auto findItr = m_Records.find(outputFilePath);
+	if (findItr == m_Records.end())
+		return false;
+
+	// the output has to be exactly the one we wrote, the user could have replaced or deleted it
+	const auto& record{ findItr->second };
+	return record.inputs == inputs && record.options == options && record.output == CreateFingerprint(outputFilePath);
+}
+
+void MergeManifest::Update(const std::string& outputFilePath, Inputs inputs, std::string_view options)
+{
+	FileFingerprint output{ CreateFingerprint(outputFilePath) };
+
+	std::scoped_lock lock(m_RecordsMutex);
+	m_Records[outputFilePath] = OutputRecord{ std::move(inputs), std::move(output), std::string(options) };
+}
+
+void MergeManifest::Prune(const std::vector<std::string>& keepOutputs)
+{
+	const std::unordered_set<std::string> keep(keepOutputs.begin(), keepOutputs.end());
+
+	std::scoped_lock lock(m_RecordsMutex);
+
+	for (auto itr = m_Records.begin(); itr != m_Records.end();)
+	{
+		if (keep.contains(itr->first))
+		{
+			++itr;
+			continue;
+		}
+
+		// no mod overwrites this file anymore, leaving it would still load the old merge in game
+		std::error_code errorCode{};
+		fs::remove(itr->first, errorCode);
+		itr = m_Records.erase(itr);
+	}
+}
+
+void MergeManifest::Load()
+{
+	std::ifstream fileStream(m_ManifestFilePath);
+	if (!fileStream.is_open())
+		return;
+
+	auto readFingerprint = [](const nlohmann::json& value)
+		{
+			return FileFingerprint{
+				value.at("path").get<std::string>(),
+				value.at("size").get<uintmax_t>(),
+				value.at("lastWriteTime").get<int64_t>() };
+		};
+
+	try
+	{
+		nlohmann::json json;
+		fileStream >> json;
+
+		std::scoped_lock lock(m_RecordsMutex);
+		for (const auto& [outputFilePath, value] : json.items())
+		{
+			OutputRecord record{};
+			for (const auto& input : value.at("inputs"))
+			{
+				record.inputs.emplace_back(readFingerprint(input));
+			}
+
+			record.output = readFingerprint(value.at("output"));
+			record.options = value.value("options", "");
+			m_Records[outputFilePath] = std::move(record);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		// a broken manifest only means a full merge
+		Logger::Error(e.what());
+		m_Records.clear();
+	}
+}
+
+void MergeManifest::Save() const
+{
+	auto writeFingerprint = [](const FileFingerprint& fingerprint)
+		{
+			return nlohmann::json{
+				{ "path", fingerprint.path },
+				{ "size", fingerprint.size },
+				{ "lastWriteTime", fingerprint.lastWriteTime } };
+		};
+
+	nlohmann::json json = nlohmann::json::object();
+	{
+		std::scoped_lock lock(m_RecordsMutex);
+		for (const auto& [outputFilePath, record] : m_Records)
+		{
+			nlohmann::json inputs = nlohmann::json::array();
+			for (const auto& input : record.inputs)
+			{
+				inputs.emplace_back(writeFingerprint(input));
+			}
+
+			json[outputFilePath] = {
+				{ "inputs", inputs },
+				{ "output", writeFingerprint(record.output) },
+				{ "options", record.options } };
+		}
+	}
+
+	try
+	{
+		const fs::path manifestPath{ m_ManifestFilePath };
+		fs::create_directories(manifestPath.parent_path());
+
+		fs::path tempManifestPath{ manifestPath };
+		tempManifestPath += ".tmp";
+
+		{
+			std::ofstream outputFile(tempManifestPath);
+			outputFile << json.dump(4);
+		}
+
+		fs::rename(tempManifestPath, manifestPath);
+	}
+	catch (const std::exception& e)
+	{
+		Logger::Error("Failed to write to file: ", m_ManifestFilePath, " ", e.what());
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+
+/// <summary>
+/// Remembers which inputs produced each output archive (main file and mods in order,
+/// with their size and write time) so the next merge only rebuilds what changed
+/// </summary>
+class MergeManifest
+{
+public:
+
+	struct FileFingerprint
+	{
+		std::string path;
+		uintmax_t size{};
+		int64_t lastWriteTime{};
+
+		bool operator==(const FileFingerprint&) const = default;
+	};
+
+	using Inputs = std::vector<FileFingerprint>;
+
+	explicit MergeManifest(std::string_view manifestFilePath);
+
+	// Fingerprint the main file followed by every mod in overwrite order
+	static Inputs CreateInputs(std::string_view mainFilePath, const std::vector<std::string>& pathToMods);
+
+	// options covers whatever else changes the output, like the codec and compression profile
+	bool IsUpToDate(const std::string& outputFilePath, const Inputs& inputs, std::string_view options = {}) const;
+	void Update(const std::string& outputFilePath, Inputs inputs, std::string_view options = {});
+
+	// Forget and delete every output that isn't in keepOutputs anymore
+	void Prune(const std::vector<std::string>& keepOutputs);
+
+	void Load();
+	void Save() const;
+
+private:
+
+	struct OutputRecord
+	{
+		Inputs inputs;
+		FileFingerprint output;
+		std::string options;
+	};
+
+	std::unordered_map<std::string, OutputRecord> m_Records;
+	mutable std::mutex m_RecordsMutex;
+
+	std::string m_ManifestFilePath;
+};
+
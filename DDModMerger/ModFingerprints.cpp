@@ -0,0 +1,326 @@
+#include "ModFingerprints.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "nlohmann/json.hpp"
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// FNV-1a, it has to give the same hash in the next session, std::hash doesn't promise that
+	constexpr uint64_t HashSeed{ 14695981039346656037ull };
+
+	uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const auto* bytes{ static_cast<const unsigned char*>(data) };
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	uint64_t HashString(uint64_t hash, std::string_view text)
+	{
+		// the size too so "ab"+"c" and "a"+"bc" don't hash the same
+		const uint64_t size{ text.size() };
+		hash = HashBytes(hash, &size, sizeof(size));
+		return HashBytes(hash, text.data(), text.size());
+	}
+
+	uint64_t HashFolder(const std::vector<ModFingerprints::Node>& children)
+	{
+		uint64_t hash{ HashSeed };
+		for (const auto& child : children)
+		{
+			hash = HashString(hash, child.name);
+			hash = HashBytes(hash, &child.hash, sizeof(child.hash));
+		}
+
+		return hash;
+	}
+
+	ModFingerprints::Node CreateFolderNode(
+		const fs::path& folderPath,
+		std::string name,
+		std::string_view extension,
+		powe::details::DirectoryTree& fileMap)
+	{
+		ModFingerprints::Node folder{ std::move(name), 0, {}, true };
+
+		std::error_code error{};
+		for (const auto& entry : fs::directory_iterator(folderPath, fs::directory_options::skip_permission_denied, error))
+		{
+			if (entry.is_directory(error))
+			{
+				folder.children.emplace_back(CreateFolderNode(entry.path(), entry.path().filename().string(), extension, fileMap));
+			}
+			else if (entry.is_regular_file(error) && entry.path().extension() == extension)
+			{
+				// the directory listing already has both on Windows, no extra call per archive
+				const uint64_t size{ entry.file_size(error) };
+				const int64_t lastWriteTime{ int64_t(entry.last_write_time(error).time_since_epoch().count()) };
+
+				ModFingerprints::Node file{ entry.path().filename().string() };
+				file.hash = HashString(HashSeed, file.name);
+				file.hash = HashBytes(file.hash, &size, sizeof(size));
+				file.hash = HashBytes(file.hash, &lastWriteTime, sizeof(lastWriteTime));
+				folder.children.emplace_back(std::move(file));
+
+				fileMap[entry.path().stem().string()] = entry.path().string();
+			}
+		}
+
+		std::sort(folder.children.begin(), folder.children.end(), [](const auto& lhs, const auto& rhs)
+			{
+				return lhs.name < rhs.name;
+			});
+
+		folder.hash = HashFolder(folder.children);
+		return folder;
+	}
+
+	void CollectArchives(const ModFingerprints::Node& node, std::vector<std::string>& archiveNames)
+	{
+		if (!node.isFolder)
+		{
+			archiveNames.emplace_back(fs::path(node.name).stem().string());
+			return;
+		}
+
+		for (const auto& child : node.children)
+		{
+			CollectArchives(child, archiveNames);
+		}
+	}
+
+	// Only goes down where the hashes differ, an unchanged folder is one comparison however much is in it
+	void CollectChangedArchives(const ModFingerprints::Node& oldNode, const ModFingerprints::Node& newNode, std::vector<std::string>& archiveNames)
+	{
+		if (oldNode.hash == newNode.hash && oldNode.isFolder == newNode.isFolder)
+			return;
+
+		if (!oldNode.isFolder || !newNode.isFolder)
+		{
+			CollectArchives(oldNode, archiveNames);
+			CollectArchives(newNode, archiveNames);
+			return;
+		}
+
+		// both are sorted by name
+		auto oldItr{ oldNode.children.begin() };
+		auto newItr{ newNode.children.begin() };
+		while (oldItr != oldNode.children.end() || newItr != newNode.children.end())
+		{
+			if (newItr == newNode.children.end() || (oldItr != oldNode.children.end() && oldItr->name < newItr->name))
+			{
+				CollectArchives(*oldItr++, archiveNames);
+			}
+			else if (oldItr == oldNode.children.end() || newItr->name < oldItr->name)
+			{
+				CollectArchives(*newItr++, archiveNames);
+			}
+			else
+			{
+				CollectChangedArchives(*oldItr++, *newItr++, archiveNames);
+			}
+		}
+	}
+
+	nlohmann::json WriteNode(const ModFingerprints::Node& node)
+	{
+		nlohmann::json json{ { "hash", node.hash } };
+		if (node.isFolder)
+		{
+			nlohmann::json children = nlohmann::json::array();
+			for (const auto& child : node.children)
+			{
+				children.emplace_back(WriteNode(child));
+				children.back()["name"] = child.name;
+			}
+
+			json["children"] = std::move(children);
+		}
+
+		return json;
+	}
+
+	ModFingerprints::Node ReadNode(const nlohmann::json& json, std::string name)
+	{
+		ModFingerprints::Node node{ std::move(name), json.at("hash").get<uint64_t>() };
+
+		if (const auto childrenItr = json.find("children"); childrenItr != json.end())
+		{
+			node.isFolder = true;
+			for (const auto& child : *childrenItr)
+			{
+				node.children.emplace_back(ReadNode(child, child.at("name").get<std::string>()));
+			}
+		}
+
+		return node;
+	}
+}
+
+ModFingerprints::ModFingerprints(std::string_view cacheFilePath)
+	: m_CacheFilePath(cacheFilePath)
+{
+}
+
+ModFingerprints::Fingerprint ModFingerprints::Create(const std::string& modPath, std::string_view extension)
+{
+	Fingerprint fingerprint{};
+	fingerprint.root = CreateFolderNode(modPath, {}, extension, fingerprint.fileMap);
+	return fingerprint;
+}
+
+std::vector<std::string> ModFingerprints::Update(const std::string& modPath, Node root)
+{
+	std::vector<std::string> archiveNames{};
+
+	std::scoped_lock lock(m_Mutex);
+
+	auto [treeItr, isNew] = m_ModTrees.try_emplace(modPath);
+	if (isNew)
+	{
+		CollectArchives(root, archiveNames);
+	}
+	else
+	{
+		CollectChangedArchives(treeItr->second, root, archiveNames);
+	}
+
+	treeItr->second = std::move(root);
+	m_ChangedArchives.insert(archiveNames.begin(), archiveNames.end());
+
+	return archiveNames;
+}
+
+std::vector<std::string> ModFingerprints::Remove(const std::string& modPath)
+{
+	std::vector<std::string> archiveNames{};
+
+	std::scoped_lock lock(m_Mutex);
+
+	const auto treeItr{ m_ModTrees.find(modPath) };
+	if (treeItr == m_ModTrees.end())
+		return archiveNames;
+
+	CollectArchives(treeItr->second, archiveNames);
+	m_ModTrees.erase(treeItr);
+	m_ChangedArchives.insert(archiveNames.begin(), archiveNames.end());
+
+	return archiveNames;
+}
+
+std::vector<std::string> ModFingerprints::Prune(const std::vector<std::string>& keepModPaths)
+{
+	const std::unordered_set<std::string> keepSet(keepModPaths.begin(), keepModPaths.end());
+	std::vector<std::string> archiveNames{};
+
+	std::scoped_lock lock(m_Mutex);
+
+	std::erase_if(m_ModTrees, [&keepSet, &archiveNames](const auto& modTree)
+		{
+			if (keepSet.contains(modTree.first))
+				return false;
+
+			CollectArchives(modTree.second, archiveNames);
+			return true;
+		});
+
+	m_ChangedArchives.insert(archiveNames.begin(), archiveNames.end());
+	return archiveNames;
+}
+
+std::unordered_set<std::string> ModFingerprints::GetChangedArchives() const
+{
+	std::scoped_lock lock(m_Mutex);
+	return m_ChangedArchives;
+}
+
+void ModFingerprints::RemoveChangedArchives(const std::unordered_set<std::string>& archiveNames)
+{
+	std::scoped_lock lock(m_Mutex);
+	std::erase_if(m_ChangedArchives, [&archiveNames](const std::string& archiveName)
+		{
+			return archiveNames.contains(archiveName);
+		});
+}
+
+void ModFingerprints::Load()
+{
+	std::ifstream fileStream(m_CacheFilePath);
+	if (!fileStream.is_open())
+		return;
+
+	try
+	{
+		nlohmann::json json;
+		fileStream >> json;
+
+		std::scoped_lock lock(m_Mutex);
+		for (const auto& [modPath, tree] : json.at("mods").items())
+		{
+			m_ModTrees[modPath] = ReadNode(tree, {});
+		}
+
+		for (const auto& archiveName : json.at("changedArchives"))
+		{
+			m_ChangedArchives.insert(archiveName.get<std::string>());
+		}
+	}
+	catch (const std::exception& e)
+	{
+		// a broken cache only means every mod counts as new
+		Logger::Error(e.what());
+
+		std::scoped_lock lock(m_Mutex);
+		m_ModTrees.clear();
+		m_ChangedArchives.clear();
+	}
+}
+
+void ModFingerprints::Save() const
+{
+	nlohmann::json json{ { "mods", nlohmann::json::object() } };
+	{
+		std::scoped_lock lock(m_Mutex);
+		for (const auto& [modPath, tree] : m_ModTrees)
+		{
+			json["mods"][modPath] = WriteNode(tree);
+		}
+
+		json["changedArchives"] = m_ChangedArchives;
+	}
+
+	// written from the scan and the watcher, one at a time
+	static std::mutex saveMutex{};
+	std::scoped_lock lock(saveMutex);
+
+	try
+	{
+		const fs::path cachePath{ m_CacheFilePath };
+		fs::create_directories(cachePath.parent_path());
+
+		fs::path tempCachePath{ cachePath };
+		tempCachePath += ".tmp";
+
+		{
+			std::ofstream outputFile(tempCachePath);
+			outputFile << json.dump();
+		}
+
+		fs::rename(tempCachePath, cachePath);
+	}
+	catch (const std::exception& e)
+	{
+		Logger::Error("Failed to write to file: ", m_CacheFilePath, " ", e.what());
+	}
+}
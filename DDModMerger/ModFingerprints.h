@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+
+#include "Types.h"
+
+/// <summary>
+/// A Merkle tree per mod folder: every archive hashes its name, size and write time, every folder the hashes
+/// of what's in it, so the root hash changes with any archive under it.
+/// The trees of the last scan are kept in ./cache. A mod with the same root hash as last time is unchanged,
+/// for one without, only the folders whose hashes differ are walked to find the archives that changed.
+/// Those archives need their output rebuilt and are remembered until a merge goes through
+/// </summary>
+class ModFingerprints
+{
+public:
+
+	struct Node
+	{
+		std::string name;
+		uint64_t hash{};
+		std::vector<Node> children{}; // sorted by name, empty for an archive
+		bool isFolder{};
+	};
+
+	struct Fingerprint
+	{
+		Node root;
+		powe::details::DirectoryTree fileMap; // the same as RecursiveFileSearch finds, not saved
+	};
+
+	explicit ModFingerprints(std::string_view cacheFilePath);
+
+	// One walk through the mod gives both its tree and its archives
+	static Fingerprint Create(const std::string& modPath, std::string_view extension);
+
+	// Compares with what the last scan saw and remembers the new tree.
+	// Returns the names of the archives that were added, removed or changed, every archive of a mod that's new
+	std::vector<std::string> Update(const std::string& modPath, Node root);
+
+	// The mod is gone, all of its archives changed
+	std::vector<std::string> Remove(const std::string& modPath);
+
+	// Forget every mod that isn't in keepModPaths, what they had changes too
+	std::vector<std::string> Prune(const std::vector<std::string>& keepModPaths);
+
+	std::unordered_set<std::string> GetChangedArchives() const;
+
+	// Those archives were merged, only what changed after that is still pending
+	void RemoveChangedArchives(const std::unordered_set<std::string>& archiveNames);
+
+	void Load();
+	void Save() const;
+
+private:
+
+	std::unordered_map<std::string, Node> m_ModTrees;
+	std::unordered_set<std::string> m_ChangedArchives;
+	mutable std::mutex m_Mutex;
+
+	std::string m_CacheFilePath;
+};
@@ -1,5 +1,4 @@
 #include "ModMerger.h"
-#include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <set>
@@ -8,28 +7,64 @@
 #include <algorithm>
 #include <execution>
 #include <regex>
+#include <charconv>
+#include <optional>
+#include <sstream>
 
 #include "nlohmann/json.hpp"
+#include "thread_pool/thread_pool.h"
 #include "EnvironmentVariables.h"
 #include "openssl/sha.h"
 #include "utils.h"
 #include "LowFrequencyThreadPool.h"
+#include "EntryCodec.h"
+#include "ARCPacker.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "IOThrottle.h"
+#include "FrameScheduler.h"
+#include "FlatHashMap.h"
+#include "ProcessRunner.h"
 
-#ifdef _WIN32
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+namespace fs = std::filesystem;
 
-#ifdef max
-#undef max
-#endif
+constexpr char MergeManifestFilePath[] = "./cache/mergeManifest.json";
 
-#ifdef min
-#undef min
-#endif
+// -staging moves this somewhere faster, a tmpfs or an SSD
+constexpr char DefaultStagingRootPath[] = "./mergeRoom";
 
-#endif
+// How often a wait checks if the merge got cancelled
+constexpr std::chrono::milliseconds CancelPollInterval{ 50 };
 
-namespace fs = std::filesystem;
+// Used when the TOC can't be read, archives usually inflate to about this much
+constexpr uint64_t FallbackInflateRatio{ 3 };
+
+// Archives ARCTool gets per start. The usual ARCTool script only takes one, -arctool-batch turns batching on
+constexpr uint32_t DefaultARCToolBatchSize{ 1 };
+
+// The memory budget when the RAM size can't be read. A budget of 0 would let only one merge run at a time
+constexpr uint64_t FallbackMemoryBudget{ 2ull << 30 };
+
+// A number from the command line, nothing when it's missing or a typo. A typo keeps the default and says so
+template<typename T>
+std::optional<T> ReadNumberCVar(const CVarReader& cVarReader, const std::string& cVar)
+{
+	if (!cVarReader.HasCVar(cVar))
+		return std::nullopt;
+
+	const std::string text{ cVarReader.ReadCVar(cVar) };
+	const char* textEnd{ text.data() + text.size() };
+
+	T value{};
+	const auto [end, error] { std::from_chars(text.data(), textEnd, value) };
+	if (error != std::errc{} || end != textEnd)
+	{
+		Logger::Warning("Ignoring ", cVar, " ", text, ", it has to be a whole number");
+		return std::nullopt;
+	}
+
+	return value;
+}
 
 void RenameFileToFolder(std::string_view sourceFilePath, std::string_view destinationFolder)
 {
@@ -46,103 +81,77 @@ void RenameFileToFolder(const fs::path& sourceFilePath, const fs::path& destinat
 }
 
 
-void SetConsoleColor(uint16_t color) {
-#ifdef _WIN32
-	HANDLE hConsole = GetStdHandle(STD_ERROR_HANDLE);
-	SetConsoleTextAttribute(hConsole, color);
-#endif
-}
+// Function to calculate SHA-256 hash of a file
+std::vector<unsigned char> CalculateSHA256(const fs::path& filePath) {
+	std::ifstream fileStream(filePath, std::ios::binary);
+	std::vector<unsigned char> fileBuffer(std::istreambuf_iterator<char>(fileStream), {});
 
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256(fileBuffer.data(), fileBuffer.size(), hash);
 
-/// <summary>
-/// This function will call ARCTool from FluffyQuack to unpack our arc files
-/// </summary>
-void CallARCTool(const fs::path& itemPath, const fs::path& arctoolPath)
-{
-#ifdef _WIN32
+	return std::vector<unsigned char>(hash, hash + SHA256_DIGEST_LENGTH);
+}
 
-	STARTUPINFO si{ sizeof(si) };
-	PROCESS_INFORMATION pi{};
-
-	const std::string cmdLine = fs::absolute(arctoolPath).string() + " " + fs::absolute(itemPath).string();
-
-	// Convert the command line string to wide character string
-	int wideCharLength = MultiByteToWideChar(CP_UTF8, 0, cmdLine.c_str(), -1, NULL, 0);
-	std::vector<wchar_t> wideCmdLine(wideCharLength);
-	MultiByteToWideChar(CP_UTF8, 0, cmdLine.c_str(), -1, wideCmdLine.data(), wideCharLength);
-
-	// CreateProcess requires a non-const wchar_t* as the command line argument, hence the copy
-	std::vector<wchar_t> cmdLineCStr(wideCmdLine.begin(), wideCmdLine.end());
-	cmdLineCStr.push_back('\0'); // Null-terminate the string
-
-	// Start the child process
-	if (!CreateProcess(
-		NULL,           // No module name (use command line)
-		cmdLineCStr.data(), // Command line
-		NULL,           // Process handle not inheritable
-		NULL,           // Thread handle not inheritable
-		FALSE,          // Set handle inheritance to FALSE
-		CREATE_NEW_CONSOLE,
-		NULL,           // Use parent's environment block
-		NULL,           // Use parent's starting directory
-		&si,            // Pointer to STARTUPINFO structure
-		&pi))            // Pointer to PROCESS_INFORMATION structure)
-	{
-		std::cerr << "CreateProcess failed (" << GetLastError() << ").\n";
-	}
-	else {
-
-		// Assuming pi.hProcess is the handle to the external process
-		DWORD timeout = (DWORD)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::minutes(3)).count(); // Timeout of 3 minutes
-		DWORD result = WaitForSingleObject(pi.hProcess, timeout);
-
-		if (result == WAIT_TIMEOUT) {
-			DWORD exitCode;
-			if (!GetExitCodeProcess(pi.hProcess, &exitCode)) {
-				SetConsoleColor(FOREGROUND_RED); // Set text color to red
-				std::cerr << "Failed to get exit code (" << GetLastError() << ").\n";
-				SetConsoleColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE); // Reset text color to default
-			}
-			else if (exitCode == STILL_ACTIVE) {
-				// Process is still running, attempt to terminate
-				if (!TerminateProcess(pi.hProcess, 0)) {
-					SetConsoleColor(FOREGROUND_RED); // Set text color to red
-					std::cerr << "Failed to terminate the process (" << GetLastError() << ").\n";
-					SetConsoleColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE); // Reset text color to default
-				}
-			}
-		}
 
-		// Close process and thread handles
-		CloseHandle(pi.hProcess);
-		CloseHandle(pi.hThread);
-	}
+// The same entry in two mods, \\ and / are one separator. The filesystem on Windows doesn't care about case either
+constexpr char NormalizeEntryPathChar(char c)
+{
+	if (c == '\\')
+		return '/';
 
+#ifdef _WIN32
+	if (c >= 'A' && c <= 'Z')
+		return char(c - 'A' + 'a');
 #endif
+
+	return c;
 }
 
-void CallARCTool(std::string_view pathToItem, std::string_view pathToARCTool)
+struct EntryPathHash
 {
-	CallARCTool(fs::path(pathToItem), fs::path(pathToARCTool));
-}
+	// FNV-1a over the normalized path, nothing gets copied to normalize it first
+	uint64_t operator()(std::string_view entryPath) const
+	{
+		uint64_t hash{ 14695981039346656037ull };
+		for (const char c : entryPath)
+		{
+			hash ^= uint64_t(uint8_t(NormalizeEntryPathChar(c)));
+			hash *= 1099511628211ull;
+		}
 
-// Function to calculate SHA-256 hash of a file
-std::vector<unsigned char> CalculateSHA256(const fs::path& filePath) {
-	std::ifstream fileStream(filePath, std::ios::binary);
-	std::vector<unsigned char> fileBuffer(std::istreambuf_iterator<char>(fileStream), {});
+		return hash;
+	}
+};
 
-	unsigned char hash[SHA256_DIGEST_LENGTH];
-	SHA256(fileBuffer.data(), fileBuffer.size(), hash);
+struct EntryPathEqual
+{
+	bool operator()(std::string_view lhs, std::string_view rhs) const
+	{
+		return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char lhsChar, char rhsChar)
+			{
+				return NormalizeEntryPathChar(lhsChar) == NormalizeEntryPathChar(rhsChar);
+			});
+	}
+};
 
-	return std::vector<unsigned char>(hash, hash + SHA256_DIGEST_LENGTH);
+// From testing there's multiple mismatch of localization files
+// that is not part of the mod but it's a different version of the same file
+// so we need to ignore them
+bool IsLocalizationVariant(const std::string& fileName)
+{
+	static const std::regex pattern("_(?:eng|fre|ger|ita|jpn|spa|zht).");
+	return std::regex_search(fileName, pattern);
 }
 
-
 void RecursiveCompareDirAsync(std::string_view baseSource, const std::string& source, std::string_view target, std::shared_ptr<CompareDirectoriesArgs> args)
 {
+	const Tracer::Scope traceScope{ "compare", target };
 
 	for (const auto& entry : fs::directory_iterator(source)) {
 
+		if (args->stopToken.stop_requested())
+			break;
+
 		if (entry.is_regular_file()) {
 
 			fs::path relativePath = fs::relative(entry.path(), baseSource);
@@ -150,25 +159,27 @@ void RecursiveCompareDirAsync(std::string_view baseSource, const std::string& so
 
 			// Check for existence
 			if (!fs::exists(comparisonPath)) {
-				std::cout << "Missing from main: " << comparisonPath << std::endl;
+				Logger::Debug("Missing from main: ", comparisonPath);
 				continue;
 			}
 
-			// From testing there's multiple mismatch of localization files
-			// that is not part of the mod but it's a different version of the same file
-			// so we need to ignore them
-			const std::regex pattern("_(?:eng|fre|ger|ita|jpn|spa|zht).");
-			if (std::regex_search(comparisonPath.filename().string(), pattern))
+			if (IsLocalizationVariant(comparisonPath.filename().string()))
 			{
 				continue;
 			}
 
 
-			auto hash1 = CalculateSHA256(entry.path());
-			auto hash2 = CalculateSHA256(comparisonPath);
+			std::vector<unsigned char> hash1{};
+			std::vector<unsigned char> hash2{};
+			{
+				const Tracer::Scope hashScope{ "hash", target, entry.file_size() };
+				hash1 = CalculateSHA256(entry.path());
+				hash2 = CalculateSHA256(comparisonPath);
+			}
+
 			if (hash1 != hash2)
 			{
-				std::cout << "Content differs: " << comparisonPath << std::endl;
+				Logger::Debug("Content differs: ", comparisonPath);
 
 				{
 					std::scoped_lock lock(args->filesToMoveMutex);
@@ -177,7 +188,7 @@ void RecursiveCompareDirAsync(std::string_view baseSource, const std::string& so
 			}
 
 		}
-		else if (entry.is_directory())
+		else if (entry.is_directory() && !args->stopToken.stop_requested())
 		{
 			args->activeTasks.get().fetch_add(1, std::memory_order_relaxed);
 			ThreadPool::EnqueueDetach(RecursiveCompareDirAsync, baseSource, entry.path().string(), target, args);
@@ -189,11 +200,12 @@ void RecursiveCompareDirAsync(std::string_view baseSource, const std::string& so
 }
 
 template<typename T, typename U>
-inline std::future<std::vector<std::string>> CompareDirectoriesAsync(T&& sourcePath, U&& targetPath)
+inline std::future<std::vector<std::string>> CompareDirectoriesAsync(T&& sourcePath, U&& targetPath, std::stop_token stopToken = {})
 {
 	auto compareCheck = [
 		lbaseSource = std::forward<T>(sourcePath),
-			lpathToTarget = std::forward<U>(targetPath)]() -> std::vector<std::string>
+			lpathToTarget = std::forward<U>(targetPath),
+			stopToken]() -> std::vector<std::string>
 		{
 			std::atomic<int> activeTasks{};
 			std::mutex activeTasksMutex;
@@ -201,6 +213,7 @@ inline std::future<std::vector<std::string>> CompareDirectoriesAsync(T&& sourceP
 
 			// Compare the directories
 			std::shared_ptr<CompareDirectoriesArgs> compareArgs{ std::make_shared<CompareDirectoriesArgs>(activeTasks,waitCV) };
+			compareArgs->stopToken = stopToken;
 
 			const std::string sourcePath{ lbaseSource };
 
@@ -213,6 +226,7 @@ inline std::future<std::vector<std::string>> CompareDirectoriesAsync(T&& sourceP
 				std::string_view(lpathToTarget),
 				compareArgs);
 
+			const ThreadPoolMetrics::BlockScope blockScope{};
 			std::unique_lock lock(activeTasksMutex);
 			waitCV.wait(lock, [&activeTasks = std::as_const(activeTasks)]
 				{
@@ -225,18 +239,14 @@ inline std::future<std::vector<std::string>> CompareDirectoriesAsync(T&& sourceP
 		return LowFrequencyThreadPool::Enqueue(compareCheck);
 }
 
-std::future<void> ModMerger::UnpackAsync(std::string_view sourcePath, std::string_view targetPath)
+std::future<bool> ModMerger::UnpackAsync(std::string_view sourcePath, std::string_view targetPath)
 {
-	std::shared_ptr<std::promise<void>> threadPromise{ std::make_shared<std::promise<void>>() };
-	std::future<void> threadFuture{ threadPromise->get_future() };
+	std::shared_ptr<std::promise<bool>> threadPromise{ std::make_shared<std::promise<bool>>() };
+	std::future<bool> threadFuture{ threadPromise->get_future() };
 
-	auto copyAndUnpack = [sourcePath, targetPath, threadPromise,
-		arctool = std::string_view(m_ARCToolScriptPath)]()
+	auto copyAndUnpack = [sourcePath, targetPath, threadPromise, this]()
 		{
-			MakeBackup(sourcePath, targetPath);
-			const fs::path newBackupFilePath{ fs::path(targetPath) / fs::path(sourcePath).filename() };
-			CallARCTool(newBackupFilePath, arctool);
-			threadPromise->set_value();
+			threadPromise->set_value(Unpack(sourcePath, targetPath));
 		};
 
 	ThreadPool::EnqueueDetach(copyAndUnpack);
@@ -244,6 +254,60 @@ std::future<void> ModMerger::UnpackAsync(std::string_view sourcePath, std::strin
 	return threadFuture;
 }
 
+bool ModMerger::Unpack(std::string_view sourcePath, std::string_view targetPath) const
+{
+	if (m_StopToken.stop_requested())
+		return false;
+
+	std::error_code errorCode{};
+	const uint64_t archiveSize{ fs::file_size(sourcePath, errorCode) };
+
+	{
+		// read from wherever the archive is, written to staging. Always in this order so two permits never deadlock
+		const IOThrottle::Permit sourcePermit{ IOThrottle::Acquire(sourcePath, IOStage::Transfer, archiveSize, m_StopToken) };
+		const IOThrottle::Permit stagingPermit{ IOThrottle::Acquire(IODevice::Staging, IOStage::Transfer, archiveSize, m_StopToken) };
+		if (!sourcePermit.IsValid() || !stagingPermit.IsValid())
+			return false;
+
+		if (m_EntryCodec)
+		{
+			const Tracer::Scope traceScope{ "unpack", sourcePath, archiveSize };
+
+			// no need for a copy, entries are read straight from the source
+			const fs::path unpackFolder{ fs::path(targetPath) / fs::path(sourcePath).stem() };
+			if (!powe::UnpackARC(sourcePath, unpackFolder, *m_EntryCodec, m_StopToken))
+			{
+				if (!m_StopToken.stop_requested())
+					Logger::Error("Failed to unpack ", sourcePath);
+
+				return false;
+			}
+
+			return true;
+		}
+
+		const Tracer::Scope traceScope{ "copy", sourcePath, archiveSize };
+		if (!MakeBackup(sourcePath, targetPath))
+		{
+			Logger::Error("Failed to copy ", sourcePath, " to ", targetPath);
+			return false;
+		}
+	}
+
+	// the permits only cover the copy, a batch waiting on ARCTool would hold them all and stay as small as the limit
+	const Tracer::Scope traceScope{ "unpack", sourcePath, archiveSize };
+	const fs::path newBackupFilePath{ fs::path(targetPath) / fs::path(sourcePath).filename() };
+	if (!m_ARCToolBatcher->Run(newBackupFilePath, m_StopToken))
+	{
+		if (!m_StopToken.stop_requested())
+			Logger::Error("Failed to unpack ", sourcePath);
+
+		return false;
+	}
+
+	return true;
+}
+
 std::future<void> ModMerger::MergeAsync(
 	std::string_view mainFilePath,
 	const std::vector<std::string>& pathToMods,
@@ -255,23 +319,24 @@ std::future<void> ModMerger::MergeAsync(
 
 	auto merge = [mainFilePath, &pathToMods, &dirTree, this]()
 		{
-			fs::path tempFolder{ "./mergeRoom" };
+			const auto workspace{ m_StagingManager.Acquire() };
+			const fs::path& tempFolder{ workspace.GetPath() };
 
 			const fs::path mainFileFS{ mainFilePath };
 			const std::string mainFileName{ mainFileFS.stem().string() };
 
-			tempFolder /= mainFileName;
-
 			const fs::path mainUnpackFolder{ (tempFolder / mainFileName) };
 
 
 			{
 				// now we just go a list of files that we need to move to sourcePath
 				auto cleanFilesToMove{ PrepareForMerge(mainFilePath, tempFolder.string(), pathToMods) };
+				if (!cleanFilesToMove)
+					return;
 
 				try
 				{
-					std::for_each(std::execution::par_unseq, cleanFilesToMove.begin(), cleanFilesToMove.end(),
+					std::for_each(std::execution::par_unseq, cleanFilesToMove->begin(), cleanFilesToMove->end(),
 						[&tempFolder, &dirTree, this](const std::string& file)
 						{
 							std::string modName{ file.substr(tempFolder.string().size() + 1) }; // get rid of temp folder's name
@@ -281,13 +346,13 @@ std::future<void> ModMerger::MergeAsync(
 				}
 				catch (const fs::filesystem_error& e)
 				{
-					std::cerr << "Error: " << e.what() << '\n';
+					Logger::Error(e.what());
 				}
 
 			}
 
 			// Repack
-			CallARCTool(mainUnpackFolder, m_ARCToolScriptPath);
+			m_ARCToolBatcher->Run(mainUnpackFolder);
 
 			// move the main file to respective folder
 			// should be out/nativePC/rom
@@ -295,17 +360,15 @@ std::future<void> ModMerger::MergeAsync(
 				fs::path outFilePath{ m_OutputFolderPath };
 				outFilePath /= mainFilePath.substr(m_SearchFolderPath.size() + 1); // get rid of top level folder
 				fs::create_directories(outFilePath.parent_path());
-				fs::rename((tempFolder / mainFileFS.filename()), outFilePath);
+				MoveFileAcrossVolumes((tempFolder / mainFileFS.filename()), outFilePath);
 			}
-
-			fs::remove_all(tempFolder);
 		};
 
 
 	return LowFrequencyThreadPool::Enqueue(merge);
 }
 
-std::vector<std::string> ModMerger::PrepareForMerge(std::string_view mainFilePath, std::string_view unpackPath, const std::vector<std::string>& modsPath)
+std::optional<std::vector<std::string>> ModMerger::PrepareForMerge(std::string_view mainFilePath, std::string_view unpackPath, const std::vector<std::string>& modsPath)
 {
 	// compare mod files to the main file and keep the result then
 	// check the result with another mod files if it has any matches
@@ -326,8 +389,9 @@ std::vector<std::string> ModMerger::PrepareForMerge(std::string_view mainFilePat
 	{
 		// we expect all mods file and one main file to unpack and main thread
 		std::barrier barrier{ uint32_t(modsPath.size() + 2) };
+		std::atomic_bool unpackFailed{};
 
-		UnpackBarrier(mainFilePath, unpackPath, barrier);
+		UnpackBarrier(mainFilePath, unpackPath, barrier, unpackFailed);
 
 		for (size_t i = 0; i < modsPath.size(); i++)
 		{
@@ -341,82 +405,119 @@ std::vector<std::string> ModMerger::PrepareForMerge(std::string_view mainFilePat
 				modName.begin(), modName.end(), [](char c) { return std::isspace(c) || c == '.'; }), modName.end());
 
 			modsNames.emplace_back(modName);
-			UnpackBarrier(modsPath[i], (unpackFS / modName).string(), barrier);
+			UnpackBarrier(modsPath[i], (unpackFS / modName).string(), barrier, unpackFailed);
 		}
 
 
-		barrier.arrive_and_wait();
+		{
+			const ThreadPoolMetrics::BlockScope blockScope{};
+			barrier.arrive_and_wait();
+		}
+
+		// a mod missing from the compare would leave its entries out of the archive without a word
+		if (unpackFailed.load(std::memory_order_relaxed))
+			return std::nullopt;
 	}
 
 
+	// every changed file of a mod is <unpackPath>/<mod name>/<main file stem>/<entry path>
+	std::vector<size_t> modsEntryPathOffsets{};
+	modsEntryPathOffsets.reserve(modsPath.size());
+
 	// Compare files
 	{
 		std::vector<std::future<std::vector<std::string>>> compareFutures{};
 		compareFutures.reserve(modsPath.size());
 
-		dp::thread_pool<> localWaitThreads{ ThreadPool::Size() / 2 };
-
 		const fs::path unpackBaseSource{ unpackPath / mainFileFS.stem() };
 
-		std::barrier barrier{ uint32_t(modsPath.size() + 1) };
-
 		for (size_t i = 0; i < modsPath.size(); i++)
 		{
 
+			std::string modUnpackPath{ (unpackFS / modsNames[i] / mainFileFS.stem()).string() };
+			modsEntryPathOffsets.emplace_back(modUnpackPath.size() + 1);
+
 			compareFutures.emplace_back(CompareDirectoriesAsync(
 				unpackBaseSource.string(),
-				(unpackFS / modsNames[i] / mainFileFS.stem()).string()));
+				std::move(modUnpackPath),
+				m_StopToken));
 		}
 
+		const ThreadPoolMetrics::BlockScope blockScope{};
 		for (auto& future : compareFutures)
 		{
-			auto filesToMove{ future.get() };
-			modsLooseFiles.emplace_back(filesToMove);
+			modsLooseFiles.emplace_back(future.get());
 		}
 	}
 
+	size_t looseFileCount{};
+	for (const auto& modFiles : modsLooseFiles)
+	{
+		looseFileCount += modFiles.size();
+	}
 
-	std::unordered_map<std::string, std::string>  uniqueFiles{};
+	// Keyed by the path inside the archive, two entries with the same name in different folders are different entries.
+	// The keys point into modsLooseFiles, the value is the file that wins
+	FlatHashMap<std::string_view, std::string*, EntryPathHash, EntryPathEqual> winningFiles{ looseFileCount };
 
-	for (const auto& modFiles : modsLooseFiles) {
-		for (const auto& file : modFiles) {
-			std::string filename = fs::path(file).filename().string();
-			// Insert file into the map if not already present; this respects priority due to the loop order
-			uniqueFiles[filename] = file;
+	for (size_t i = 0; i < modsLooseFiles.size(); i++)
+	{
+		for (auto& file : modsLooseFiles[i])
+		{
+			// later mods overwrite earlier ones
+			winningFiles[std::string_view(file).substr(modsEntryPathOffsets[i])] = &file;
 		}
 	}
 
 	std::vector<std::string> outMoveFiles{};
-	for (const auto& [fileName, path] : uniqueFiles)
-	{
-		outMoveFiles.emplace_back(path);
-	}
+	outMoveFiles.reserve(winningFiles.Size());
+
+	winningFiles.ForEach([&outMoveFiles](std::string_view, std::string* file)
+		{
+			outMoveFiles.emplace_back(std::move(*file));
+		});
 
 	return outMoveFiles;
 
 }
 
-void ModMerger::Merge(
+bool ModMerger::Merge(
 	std::string_view mainFilePath,
 	const std::vector<std::string>& pathToMods,
 	const powe::details::DirectoryTree& dirTree)
 {
-	fs::path tempFolder{ "./mergeRoom" };
+	bool mergeResult{ true };
+
+	const Tracer::Scope traceScope{ "merge", mainFilePath };
+
+	// handed back when we return, the cleanup happens on the staging thread
+	const auto workspace{ m_StagingManager.Acquire() };
+	const fs::path& tempFolder{ workspace.GetPath() };
 
 	const fs::path mainFileFS{ mainFilePath };
 	const std::string mainFileName{ mainFileFS.stem().string() };
 
-	tempFolder /= mainFileName;
-
 	const fs::path mainUnpackFolder{ (tempFolder / mainFileName) };
 
 	{
 		// now we just go a list of files that we need to move to sourcePath
 		auto cleanFilesToMove{ PrepareForMerge(mainFilePath, tempFolder.string(), pathToMods) };
 
+		// whatever got unpacked so far goes away with the workspace
+		if (m_StopToken.stop_requested())
+			return false;
+
+		if (!cleanFilesToMove)
+		{
+			Logger::Error("Not merging ", mainFilePath, ", not everything could be unpacked");
+			return false;
+		}
+
 		try
 		{
-			std::for_each(std::execution::par_unseq, cleanFilesToMove.begin(), cleanFilesToMove.end(),
+			const Tracer::Scope renameScope{ "rename", mainFilePath };
+
+			std::for_each(std::execution::par_unseq, cleanFilesToMove->begin(), cleanFilesToMove->end(),
 				[&tempFolder, &dirTree, this](const std::string& file)
 				{
 					std::string modName{ file.substr(tempFolder.string().size() + 1) }; // get rid of temp folder's name
@@ -426,81 +527,393 @@ void ModMerger::Merge(
 		}
 		catch (const fs::filesystem_error& e)
 		{
-			SetConsoleColor(FOREGROUND_RED); // Set text color to red
-			std::cerr << "Error: " << e.what() << '\n';
-			SetConsoleColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE); // Reset text color to default
+			Logger::Error(e.what());
+			mergeResult = false;
 		}
 
 	}
 
 	// Repack
-	CallARCTool(mainUnpackFolder, m_ARCToolScriptPath);
+	{
+		Tracer::Scope repackScope{ "repack", mainFilePath };
+		if (m_EntryCodec)
+		{
+			const auto mainFile{ powe::ARCFile::Open(mainFilePath) };
+			CompressionPolicy compressionPolicy{ m_MergeCompressionProfile };
+			if (!mainFile || !powe::RepackARC(mainUnpackFolder, tempFolder / mainFileFS.filename(), *mainFile, *m_EntryCodec, compressionPolicy, m_StopToken))
+			{
+				if (m_StopToken.stop_requested())
+					return false;
+
+				Logger::Error("Failed to repack ", mainUnpackFolder);
+				mergeResult = false;
+			}
+		}
+		else if (!m_ARCToolBatcher->Run(mainUnpackFolder, m_StopToken) && !m_StopToken.stop_requested())
+		{
+			Logger::Error("Failed to repack ", mainUnpackFolder);
+			mergeResult = false;
+		}
+
+		// ARCTool may have been killed halfway, don't ship what it left
+		if (m_StopToken.stop_requested())
+			return false;
+
+		std::error_code errorCode{};
+		repackScope.SetBytes(fs::file_size(tempFolder / mainFileFS.filename(), errorCode));
+	}
 
 	// move the main file to respective folder
 	// should be out/nativePC/rom
+	try
 	{
-		fs::path outFilePath{ m_OutputFolderPath };
-		outFilePath /= mainFilePath.substr(m_SearchFolderPath.size() + 1); // get rid of top level folder
+		const fs::path outFilePath{ GetOutputFilePath(mainFilePath) };
 		fs::create_directories(outFilePath.parent_path());
-		fs::rename((tempFolder / mainFileFS.filename()), outFilePath);
+		if (!MoveFileAcrossVolumes((tempFolder / mainFileFS.filename()), outFilePath))
+			mergeResult = false;
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
+		mergeResult = false;
+	}
+
+	return mergeResult;
+}
+
+
+bool ModMerger::Install(std::string_view mainFilePath, std::string_view modFilePath)
+{
+	if (m_StopToken.stop_requested())
+		return false;
+
+	std::error_code errorCode{};
+	const uint64_t fileSize{ fs::file_size(modFilePath, errorCode) };
+
+	const IOThrottle::Permit permit{ IOThrottle::Acquire(modFilePath, IOStage::Transfer, fileSize, m_StopToken) };
+	if (!permit.IsValid())
+		return false;
+
+	const Tracer::Scope traceScope{ "install", modFilePath, fileSize };
+
+	try
+	{
+		const fs::path outFilePath{ GetOutputFilePath(mainFilePath) };
+		fs::create_directories(outFilePath.parent_path());
+
+		if (LinkOrCopyFile(modFilePath, outFilePath))
+			return true;
+
+		Logger::Error("Failed to install ", modFilePath);
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
+	}
+
+	return false;
+}
+
+bool ModMerger::MergeInMemory(
+	std::string_view mainFilePath,
+	const std::vector<std::string>& pathToMods)
+{
+	if (!m_EntryCodec)
+		return false;
+
+	const Tracer::Scope traceScope{ "merge in memory", mainFilePath };
+
+	try
+	{
+		const fs::path outFilePath{ GetOutputFilePath(mainFilePath) };
+		fs::create_directories(outFilePath.parent_path());
+
+		CompressionPolicy compressionPolicy{ m_MergeCompressionProfile };
+		return powe::MergeARCInMemory(mainFilePath, pathToMods, outFilePath, *m_EntryCodec, compressionPolicy,
+			[](const powe::ARCEntry& entry)
+			{
+				return IsLocalizationVariant(powe::GetUnpackedEntryPath(entry).filename().string());
+			},
+			m_StopToken);
+	}
+	catch (const fs::filesystem_error& e)
+	{
+		Logger::Error(e.what());
 	}
 
-	fs::remove_all(tempFolder);
+	return false;
 }
 
+ModMerger::MergePlan ModMerger::PlanMerge(
+	std::string_view mainFilePath,
+	const std::vector<std::string>& pathToMods) const
+{
+	MergePlan mergePlan{};
+
+	std::error_code errorCode{};
+	const uint64_t mainFileSize{ fs::file_size(mainFilePath, errorCode) };
+
+	const auto mainFile{ powe::ARCFile::Open(mainFilePath) };
+	std::unordered_set<std::string> mainKeys{};
+	if (mainFile)
+	{
+		for (const auto& entry : mainFile->GetEntries())
+		{
+			mainKeys.emplace(entry.GetKey());
+		}
+	}
+
+	// in memory needs every TOC, without them we can't tell what it will hold
+	bool canMergeInMemory{ m_EntryCodec && mainFile && m_InMemoryMergeLimit > 0 };
+
+	auto addArchive = [this, &mergePlan, &mainKeys, &canMergeInMemory](std::string_view arcPath, bool isMainFile)
+		{
+			std::error_code errorCode{};
+			const uint64_t archiveSize{ fs::file_size(arcPath, errorCode) };
+
+			uint64_t unpackedSize{ archiveSize * FallbackInflateRatio };
+			uint64_t largestEntry{ archiveSize };
+			uint64_t overwrittenSize{ unpackedSize };
+
+			if (const auto arcFile{ powe::ARCFile::Open(arcPath) })
+			{
+				unpackedSize = 0;
+				largestEntry = 0;
+				overwrittenSize = 0;
+				for (const auto& entry : arcFile->GetEntries())
+				{
+					unpackedSize += entry.decompressedSize;
+					largestEntry = std::max(largestEntry, uint64_t(entry.decompressedSize));
+
+					if (mainKeys.contains(entry.GetKey()))
+						overwrittenSize += entry.decompressedSize;
+				}
+			}
+			else
+			{
+				canMergeInMemory = false;
+			}
+
+			auto& onDiskCost{ mergePlan.onDiskCost };
+			onDiskCost.diskBytes += unpackedSize;
+
+			if (m_EntryCodec)
+			{
+				// one entry at a time, compressed and inflated
+				onDiskCost.memoryBytes += largestEntry * 2;
+			}
+			else
+			{
+				// ARCTool gets its own copy of the archive and holds it while it works
+				onDiskCost.diskBytes += archiveSize;
+				onDiskCost.memoryBytes += archiveSize;
+			}
+
+			// every mod entry the main file has may end up held until the write, plus a compare buffer for both sides
+			if (!isMainFile)
+				mergePlan.inMemoryCost.memoryBytes += overwrittenSize + largestEntry * 2;
+		};
+
+	addArchive(mainFilePath, true);
+	for (const auto& modPath : pathToMods)
+	{
+		addArchive(modPath, false);
+	}
+
+	// the repacked archive sits in staging until it's moved out
+	mergePlan.onDiskCost.diskBytes += mainFileSize;
+
+	// the main file and every mod are unpacked on the main pool at the same time
+	mergePlan.onDiskCost.workerCount = uint32_t(pathToMods.size() + 1);
+
+	// the in memory merge only writes the output
+	mergePlan.inMemoryCost.diskBytes = mainFileSize;
+
+	mergePlan.inMemory = canMergeInMemory && mergePlan.inMemoryCost.memoryBytes <= m_InMemoryMergeLimit;
+
+	return mergePlan;
+}
 
-void ModMerger::MergeContentIntern(const powe::details::DirectoryTree& dirTree, const powe::details::ModsOverwriteOrder& overwriteOrder)
+std::string ModMerger::GetMergeOptions() const
+{
+	if (!m_EntryCodec)
+		return "arctool";
+
+	return std::string(m_EntryCodec->GetName()) + ":" + std::string(GetCompressionProfileName(m_MergeCompressionProfile));
+}
+
+std::string ModMerger::GetOutputFilePath(std::string_view mainFilePath) const
+{
+	fs::path outFilePath{ m_OutputFolderPath };
+	outFilePath /= mainFilePath.substr(m_SearchFolderPath.size() + 1); // get rid of top level folder
+	return outFilePath.string();
+}
+
+void ModMerger::MergeContentIntern(
+	const powe::details::DirectoryTree& dirTree,
+	const powe::details::ModsOverwriteOrder& overwriteOrder,
+	const powe::details::BackupFutures& backupFutures)
 {
 	fs::path outputFolder{ m_OutputFolderPath };
 	outputFolder /= DEFAULT_DD_TOPLEVEL_FOLDER;
 
 	std::vector<std::future<void>> mergeFutures{};
 
-	dp::thread_pool lcoalWaitThreads{ ThreadPool::Size() / 2 };
+	// The governor decides how many merges run at once by their size and by how many pool workers
+	// their unpacks take, these threads are only there to wait
+	dp::thread_pool localWaitThreads{ ThreadPool::Size() };
 
+	// the pool is only resized between merges
+	{
+		auto limit{ m_MergeGovernor.GetUsage().limit };
+		limit.workerCount = ThreadPool::Size();
+		m_MergeGovernor.SetLimit(limit);
+	}
+
+	{
+		std::scoped_lock lock(m_UnmergedArchivesMutex);
+		m_UnmergedArchives.clear();
+	}
+
+	// one profile for the whole merge, a change in the menu only counts from the next one
+	m_MergeCompressionProfile = m_CompressionProfile.load(std::memory_order_relaxed);
+	const std::string mergeOptions{ GetMergeOptions() };
+
+
+	std::vector<std::string> outputFilePaths{};
+	outputFilePaths.reserve(overwriteOrder.size());
+
+	struct PendingMerge
+	{
+		std::string_view fileName;
+		std::string_view filePath;
+		const std::vector<std::string>* pathToMods{};
+		std::shared_future<void> backupFuture;
+		std::string outputFilePath;
+		MergeManifest::Inputs inputs;
+		MergePlan plan;
+	};
+
+	std::vector<PendingMerge> pendingMerges{};
 
 	for (const auto& [fileName, pathToMods] : overwriteOrder)
 	{
-		//if (pathToMods.size() > 1)
-		//{
-			// copy the main file to the temp folder
-		if (const auto findItr = dirTree.find(fileName); findItr != dirTree.end())
+		const auto findItr = dirTree.find(fileName);
+		if (findItr == dirTree.end())
+			continue;
+
+		if (m_StopToken.stop_requested())
+			break;
+
+		std::string outputFilePath{ GetOutputFilePath(findItr->second) };
+		outputFilePaths.emplace_back(outputFilePath);
+
+		// Same main file, same mods in the same order as last time, the output is still good
+		MergeManifest::Inputs inputs{ MergeManifest::CreateInputs(findItr->second, pathToMods) };
+		const std::string_view options{ pathToMods.size() == 1 ? std::string_view() : std::string_view(mergeOptions) };
+		if (m_MergeManifest.IsUpToDate(outputFilePath, inputs, options))
+			continue;
+
+		// it leaves again once its output is written
 		{
-			mergeFutures.emplace_back(lcoalWaitThreads.enqueue([this,
+			std::scoped_lock lock(m_UnmergedArchivesMutex);
+			m_UnmergedArchives.emplace(fileName);
+		}
+
+		// Only one mod touches this file so there's nothing to merge,
+		// the mod's file goes straight to the output folder
+		if (pathToMods.size() == 1)
+		{
+			mergeFutures.emplace_back(ThreadPool::Enqueue([this,
+				fileName = std::string_view(fileName),
 				filePath = std::string_view(findItr->second),
-				&pathToMods, &dirTree]() {
-					Merge(filePath, pathToMods, dirTree);
+				modFilePath = std::string_view(pathToMods.front()),
+				outputFilePath = std::move(outputFilePath),
+				inputs = std::move(inputs)]() {
+					if (Install(filePath, modFilePath))
+					{
+						m_MergeManifest.Update(outputFilePath, inputs);
+						SetArchiveMerged(fileName);
+					}
 				}));
+
+			continue;
+		}
+
+		std::shared_future<void> backupFuture{};
+		if (const auto backupItr = backupFutures.find(fileName); backupItr != backupFutures.end())
+		{
+			backupFuture = backupItr->second;
 		}
-		//}
+
+		pendingMerges.emplace_back(PendingMerge{
+			fileName,
+			findItr->second,
+			&pathToMods,
+			std::move(backupFuture),
+			std::move(outputFilePath),
+			std::move(inputs),
+			PlanMerge(findItr->second, pathToMods) });
 	}
 
+	// Biggest first, they run mostly alone and the small ones fill whatever budget is left
+	auto getPlannedBytes = [](const MergePlan& plan)
+		{
+			const auto& cost{ plan.inMemory ? plan.inMemoryCost : plan.onDiskCost };
+			return cost.memoryBytes + cost.diskBytes;
+		};
 
-	// TODO: Make a check box or button to copy files that is not merging to output folder
+	std::sort(pendingMerges.begin(), pendingMerges.end(), [&getPlannedBytes](const PendingMerge& lhs, const PendingMerge& rhs)
+		{
+			return getPlannedBytes(lhs.plan) > getPlannedBytes(rhs.plan);
+		});
 
-	//std::for_each(std::execution::par_unseq, overwriteOrder.begin(), overwriteOrder.end(),
-	//	[&dirTree,
-	//	output = std::string_view(m_OutputFolderPath),
-	//	searchFolder = std::string_view(m_SearchFolderPath),
-	//	modFolder = std::string_view(m_ModFolderPath)](const std::pair<std::string, std::vector<std::string>>& overwrite)
-	//	{
-	//		if (overwrite.second.size() <= 1)
-	//		{
-	//			if (const auto& findTarget = dirTree.find(overwrite.first); findTarget != dirTree.end())
-	//			{
-	//				auto& mainFilePath{ findTarget->second };
+	for (auto& pendingMerge : pendingMerges)
+	{
+		mergeFutures.emplace_back(localWaitThreads.enqueue([this, &pendingMerge, &dirTree,
+			options = std::string_view(mergeOptions)]() {
 
-	//				fs::path outFilePath{ output };
-	//				outFilePath /= mainFilePath.substr(searchFolder.size() + 1); // get rid of top level folder
-	//				fs::create_directories(outFilePath.parent_path());
+				// don't touch the main file until its backup is done
+				if (pendingMerge.backupFuture.valid())
+				{
+					while (pendingMerge.backupFuture.wait_for(CancelPollInterval) != std::future_status::ready)
+					{
+						if (m_StopToken.stop_requested())
+							return;
+					}
+				}
 
-	//				const fs::path modCopySource{ overwrite.second.front() };
+				bool mergeResult{};
 
-	//				fs::copy(modCopySource, outFilePath, fs::copy_options::overwrite_existing);
-	//			}
-	//		}
-	//	});
+				if (pendingMerge.plan.inMemory)
+				{
+					const auto ticket{ m_MergeGovernor.Acquire(pendingMerge.plan.inMemoryCost, m_StopToken) };
+					if (!ticket.IsValid())
+						return;
+
+					mergeResult = MergeInMemory(pendingMerge.filePath, *pendingMerge.pathToMods);
+				}
+
+				// too big for memory, or the in memory merge couldn't read something
+				if (!mergeResult && !m_StopToken.stop_requested())
+				{
+					const auto ticket{ m_MergeGovernor.Acquire(pendingMerge.plan.onDiskCost, m_StopToken) };
+					if (!ticket.IsValid())
+						return;
 
+					mergeResult = Merge(pendingMerge.filePath, *pendingMerge.pathToMods, dirTree);
+				}
+
+				if (mergeResult)
+				{
+					m_MergeManifest.Update(pendingMerge.outputFilePath, pendingMerge.inputs, options);
+					SetArchiveMerged(pendingMerge.fileName);
+				}
+			}));
+	}
+
+
+	// TODO: Make a check box or button to copy files that is not merging to output folder
 
 	for (auto& future : mergeFutures)
 	{
@@ -508,32 +921,142 @@ void ModMerger::MergeContentIntern(const powe::details::DirectoryTree& dirTree,
 			future.get();
 	}
 
+	// only what a whole merge saw can be pruned, a cancelled one never got to most of the outputs
+	if (m_StopToken.stop_requested())
+	{
+		Logger::Info("Merge cancelled");
+	}
+	else
+	{
+		m_MergeManifest.Prune(outputFilePaths);
+	}
+
+	m_MergeManifest.Save();
+
+	if (!m_TraceFilePath.empty())
+		Tracer::Export(m_TraceFilePath);
+
 	m_ActiveTasks.fetch_sub(1, std::memory_order_relaxed);
+	FrameScheduler::Wake();
+}
+
+void ModMerger::SetArchiveMerged(std::string_view fileName)
+{
+	std::scoped_lock lock(m_UnmergedArchivesMutex);
+	m_UnmergedArchives.erase(std::string(fileName));
+}
+
+std::unordered_set<std::string> ModMerger::GetUnmergedArchives() const
+{
+	std::scoped_lock lock(m_UnmergedArchivesMutex);
+	return m_UnmergedArchives;
 }
 
 ModMerger::ModMerger(
 	const CVarReader& cVarReader)
+	: m_MergeManifest(MergeManifestFilePath)
+	, m_MergeGovernor(MergeGovernor::Cost{})
+	, m_StagingManager(cVarReader.HasCVar("-staging") ? cVarReader.ReadCVar("-staging") : DefaultStagingRootPath)
 {
 	m_ModFolderPath = cVarReader.ReadCVar("-mods");
 	m_OutputFolderPath = cVarReader.ReadCVar("-out");
 	m_ARCToolScriptPath = cVarReader.ReadCVar("-arctool");
 	m_SearchFolderPath = cVarReader.ReadCVar("-path");
 
+	// -trace <file> writes a Chrome trace of every stage after each merge
+	if (cVarReader.HasCVar("-trace"))
+		m_TraceFilePath = cVarReader.ReadCVar("-trace");
+
 	// check all variables if they are empty then throw an exception
 	if (m_ModFolderPath.empty() || m_OutputFolderPath.empty() || m_ARCToolScriptPath.empty())
 	{
 		throw std::runtime_error("Error: One or more of the required arguments are missing");
 	}
+
+	// -arctool-runner <program> starts ARCTool through it, wine on Linux. Arguments go after it separated by spaces
+	{
+		std::vector<std::string> arctoolCommand{};
+		std::istringstream runnerStream{ cVarReader.HasCVar("-arctool-runner") ? cVarReader.ReadCVar("-arctool-runner") : "" };
+		for (std::string runnerArg; runnerStream >> runnerArg;)
+		{
+			arctoolCommand.emplace_back(std::move(runnerArg));
+		}
+
+		arctoolCommand.emplace_back(fs::absolute(m_ARCToolScriptPath).string());
+
+		// -arctool-batch <count> gives one ARCTool start up to that many archives, only for an ARCTool that takes several
+		const uint32_t batchSize{ ReadNumberCVar<uint32_t>(cVarReader, "-arctool-batch").value_or(DefaultARCToolBatchSize) };
+		m_ARCToolBatcher = std::make_unique<ARCToolBatcher>(std::move(arctoolCommand), batchSize);
+	}
+
+	// -arctool-processes caps how many ARCTools run at once, by default one per core
+	if (const auto maxProcesses{ ReadNumberCVar<uint32_t>(cVarReader, "-arctool-processes") })
+		ProcessRunner::SetMaxProcesses(*maxProcesses);
+
+	// -codec picks the entry backend, "arctool" keeps everything in ARCTool
+	const std::string codecName{ cVarReader.HasCVar("-codec") ? cVarReader.ReadCVar("-codec") : "" };
+	if (codecName != "arctool")
+	{
+		m_EntryCodec = EntryCodec::Create(codecName);
+
+		if (!m_EntryCodec && !codecName.empty())
+		{
+			Logger::Warning("Entry codec ", codecName, " isn't compiled in, using ARCTool");
+		}
+	}
+
+	// -memory-budget and -disk-budget in MB, by default a quarter of the RAM and half of the free staging space
+	{
+		MergeGovernor::Cost budget{ GetPhysicalMemoryBytes() / 4, 0, ThreadPool::Size() };
+
+		std::error_code errorCode{};
+		budget.diskBytes = fs::space(m_StagingManager.GetRootPath(), errorCode).available / 2;
+
+		if (const auto memoryBudget{ ReadNumberCVar<uint64_t>(cVarReader, "-memory-budget") })
+		{
+			budget.memoryBytes = *memoryBudget << 20;
+		}
+		else if (budget.memoryBytes == 0)
+		{
+			Logger::Warning("Can't read how much RAM there is, merges get ", FallbackMemoryBudget >> 20, " MB, -memory-budget sets it");
+			budget.memoryBytes = FallbackMemoryBudget;
+		}
+
+		if (const auto diskBudget{ ReadNumberCVar<uint64_t>(cVarReader, "-disk-budget") })
+			budget.diskBytes = *diskBudget << 20;
+
+		m_MergeGovernor.SetLimit(budget);
+
+		// -inmemory-limit in MB, archives whose merge would hold more go through staging. 0 turns it off
+		m_InMemoryMergeLimit = budget.memoryBytes / 4;
+		if (const auto inMemoryLimit{ ReadNumberCVar<uint64_t>(cVarReader, "-inmemory-limit") })
+			m_InMemoryMergeLimit = *inMemoryLimit << 20;
+	}
+
+	// each root could be its own disk, the I/O limit is tuned for each one on its own
+	IOThrottle::SetDeviceRoot(IODevice::Install, m_SearchFolderPath);
+	IOThrottle::SetDeviceRoot(IODevice::Mods, m_ModFolderPath);
+	IOThrottle::SetDeviceRoot(IODevice::Staging, m_StagingManager.GetRootPath());
+
+	if (cVarReader.HasCVar("-compression"))
+	{
+		m_CompressionProfile = ParseCompressionProfile(cVarReader.ReadCVar("-compression"));
+	}
+
+	m_MergeManifest.Load();
 }
 
 void ModMerger::MergeContent(const powe::details::DirectoryTree& dirTree, const powe::details::ModsOverwriteOrder& overwriteOrder, bool measureTime)
 {
 	if (overwriteOrder.empty())
 	{
-		std::cerr << "No mods to merge\n";
+		Logger::Warning("No mods to merge");
 		return;
 	}
 
+	m_StopSource = std::stop_source{};
+	m_StopToken = m_StopSource.get_token();
+
 	if (measureTime)
 	{
 		// measure time
@@ -541,7 +1064,7 @@ void ModMerger::MergeContent(const powe::details::DirectoryTree& dirTree, const
 		MergeContentIntern(dirTree, overwriteOrder);
 		auto end = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> elapsed = end - start;
-		std::cout << "Merge Elapsed time: " << elapsed.count() << "s\n";
+		Logger::Info("Merge Elapsed time: ", elapsed.count(), "s");
 	}
 	else
 	{
@@ -549,30 +1072,37 @@ void ModMerger::MergeContent(const powe::details::DirectoryTree& dirTree, const
 	}
 }
 
-void ModMerger::MergeContentAsync(const powe::details::DirectoryTree& dirTree, const powe::details::ModsOverwriteOrder& overwriteOrder, bool measureTime)
+void ModMerger::MergeContentAsync(
+	const powe::details::DirectoryTree& dirTree,
+	const powe::details::ModsOverwriteOrder& overwriteOrder,
+	powe::details::BackupFutures backupFutures,
+	bool measureTime)
 {
 	if (overwriteOrder.empty())
 	{
-		std::cerr << "No mods to merge\n";
+		Logger::Warning("No mods to merge");
 		return;
 	}
 
 	if (!IsReadyToMerge())
 	{
-		std::cerr << "Merge task is already running\n";
+		Logger::Warning("Merge task is already running");
 		return;
 	}
 
+	m_StopSource = std::stop_source{};
+	m_StopToken = m_StopSource.get_token();
+
 	if (measureTime)
 	{
-		auto merge = [this, &dirTree, &overwriteOrder]()
+		auto merge = [this, &dirTree, &overwriteOrder, backupFutures = std::move(backupFutures)]()
 			{
 				// measure time
 				auto start = std::chrono::high_resolution_clock::now();
-				MergeContentIntern(dirTree, overwriteOrder);
+				MergeContentIntern(dirTree, overwriteOrder, backupFutures);
 				auto end = std::chrono::high_resolution_clock::now();
 				std::chrono::duration<double> elapsed = end - start;
-				std::cout << "Merge Elapsed time: " << elapsed.count() << "s\n";
+				Logger::Info("Merge Elapsed time: ", elapsed.count(), "s");
 			};
 
 		// Single thread it's fine
@@ -581,9 +1111,9 @@ void ModMerger::MergeContentAsync(const powe::details::DirectoryTree& dirTree, c
 	}
 	else
 	{
-		auto merge = [this, &dirTree, &overwriteOrder]()
+		auto merge = [this, &dirTree, &overwriteOrder, backupFutures = std::move(backupFutures)]()
 			{
-				MergeContentIntern(dirTree, overwriteOrder);
+				MergeContentIntern(dirTree, overwriteOrder, backupFutures);
 			};
 
 		m_ActiveTasks.fetch_add(1, std::memory_order_relaxed);
@@ -591,6 +1121,16 @@ void ModMerger::MergeContentAsync(const powe::details::DirectoryTree& dirTree, c
 	}
 }
 
+void ModMerger::SetCompressionProfile(CompressionProfile profile)
+{
+	m_CompressionProfile.store(profile, std::memory_order_relaxed);
+}
+
+CompressionProfile ModMerger::GetCompressionProfile() const
+{
+	return m_CompressionProfile.load(std::memory_order_relaxed);
+}
+
 bool ModMerger::IsARCToolExist() const
 {
 	const fs::path arctool{ m_ARCToolScriptPath };
@@ -602,3 +1142,14 @@ bool ModMerger::IsReadyToMerge() const
 	return m_ActiveTasks.load(std::memory_order_relaxed) == 0;
 }
 
+void ModMerger::CancelMerge()
+{
+	if (!IsReadyToMerge())
+		m_StopSource.request_stop();
+}
+
+bool ModMerger::IsCancelling() const
+{
+	return !IsReadyToMerge() && m_StopSource.stop_requested();
+}
+
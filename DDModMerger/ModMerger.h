@@ -5,11 +5,19 @@
 #include <filesystem>
 #include <iostream>
 #include <barrier>
+#include <optional>
+#include <mutex>
+#include <unordered_set>
 
 #include "CVarReader.h"
 #include "Types.h"
 #include "ThreadPool.h"
 #include "utils.h"
+#include "MergeManifest.h"
+#include "CompressionPolicy.h"
+#include "MergeGovernor.h"
+#include "StagingManager.h"
+#include "ARCToolBatcher.h"
 
 struct CompareDirectoriesArgs
 {
@@ -26,9 +34,13 @@ struct CompareDirectoriesArgs
 
 	std::vector<std::string> filesToMove;
 	std::mutex filesToMoveMutex;
+
+	// checked per directory and per file, the rest of the walk is skipped once it's triggered
+	std::stop_token stopToken;
 };
 
-extern void CallARCTool(std::string_view pathToItem, std::string_view pathToARCTool);
+class EntryCodec;
+
 extern void RecursiveCompareDirAsync(std::string_view baseSource, const std::string& source, std::string_view target, std::shared_ptr<CompareDirectoriesArgs> args);
 
 class ModMerger
@@ -43,47 +55,121 @@ public:
 		const powe::details::ModsOverwriteOrder& overwriteOrder,
 		bool measureTime = true);
 
+	/// <summary>
+	/// Merge on a detached thread. Each main file waits for its backup future (if there's one)
+	/// before it gets unpacked so backups and merges can overlap
+	/// </summary>
 	void MergeContentAsync(
 		const powe::details::DirectoryTree& dirTree,
 		const powe::details::ModsOverwriteOrder& overwriteOrder,
+		powe::details::BackupFutures backupFutures = {},
 		bool measureTime = true);
 
 	bool IsARCToolExist() const;
 	bool IsReadyToMerge() const;
 
+	// Stops the running merge at the next entry or directory, kills ARCTool if it's running.
+	// Archives that were already merged stay merged
+	void CancelMerge();
+	bool IsCancelling() const;
+
+	// Unpack and repack happen in process instead of through ARCTool
+	bool HasEntryCodec() const { return m_EntryCodec != nullptr; }
+
+	// Archives the last merge had to build but didn't write, failed or cancelled.
+	// Only complete once IsReadyToMerge is true again
+	std::unordered_set<std::string> GetUnmergedArchives() const;
+
+	// Bytes held by the merges that are running right now against their limits
+	MergeGovernor::Usage GetMergeUsage() const { return m_MergeGovernor.GetUsage(); }
+
+	// Only used by the in process repack, takes effect on the next merge
+	void SetCompressionProfile(CompressionProfile profile);
+	CompressionProfile GetCompressionProfile() const;
+
 private:
 
 	template<typename T, typename U>
-	std::future<void> UnpackAsync(T&& sourcePath, U&& targetPath);
-	std::future<void> UnpackAsync(std::string_view sourcePath, std::string_view targetPath);
+	std::future<bool> UnpackAsync(T&& sourcePath, U&& targetPath);
+	std::future<bool> UnpackAsync(std::string_view sourcePath, std::string_view targetPath);
 
+	// Unpack sourcePath into targetPath/<stem>, false when it didn't all come out or the merge was cancelled
+	bool Unpack(std::string_view sourcePath, std::string_view targetPath) const;
+
+	// unpackFailed is set when the unpack fails, it's only ever set, never cleared
 	template<typename T, typename U>
 	void UnpackBarrier(
 		T&& sourcePath,
 		U&& targetPath,
-		std::barrier<>& barrier);
+		std::barrier<>& barrier,
+		std::atomic_bool& unpackFailed);
 
 	std::future<void> MergeAsync(std::string_view mainFilePath,
 		const std::vector<std::string>& pathToMods,
 		const powe::details::DirectoryTree& dirTree);
 
-	void Merge(std::string_view mainFilePath,
+	bool Merge(std::string_view mainFilePath,
 		const std::vector<std::string>& pathToMods,
 		const powe::details::DirectoryTree& dirTree);
 
-	std::vector<std::string> PrepareForMerge(
+	// Put a file that only one mod overwrites straight to the output folder
+	bool Install(std::string_view mainFilePath,
+		std::string_view modFilePath);
+
+	// Everything at once in memory, nothing staged. Only possible with an entry codec
+	bool MergeInMemory(std::string_view mainFilePath,
+		const std::vector<std::string>& pathToMods);
+
+	struct MergePlan
+	{
+		MergeGovernor::Cost onDiskCost;
+		MergeGovernor::Cost inMemoryCost;
+		bool inMemory{};
+	};
+
+	// Guess from the TOCs how much memory and staging disk merging this file takes
+	// and whether it's small enough to merge in memory
+	MergePlan PlanMerge(
+		std::string_view mainFilePath,
+		const std::vector<std::string>& pathToMods) const;
+
+	// Its output is written, takes it out of m_UnmergedArchives
+	void SetArchiveMerged(std::string_view fileName);
+
+	std::string GetOutputFilePath(std::string_view mainFilePath) const;
+	std::string GetMergeOptions() const;
+
+	// The files the mods change, nothing when something couldn't be unpacked
+	std::optional<std::vector<std::string>> PrepareForMerge(
 		std::string_view mainFilePath,
 		std::string_view unpackPath,
 		const std::vector<std::string>& modsPath);
 
 	void MergeContentIntern(
 		const powe::details::DirectoryTree& dirTree,
-		const powe::details::ModsOverwriteOrder& overwriteOrder);
+		const powe::details::ModsOverwriteOrder& overwriteOrder,
+		const powe::details::BackupFutures& backupFutures = {});
 
 	std::atomic_int32_t m_ActiveTasks{};
 
+	// a new source for every merge, the token is only read while that merge runs
+	std::stop_source m_StopSource;
+	std::stop_token m_StopToken;
+
+	MergeManifest m_MergeManifest;
+	mutable std::mutex m_UnmergedArchivesMutex;
+	std::unordered_set<std::string> m_UnmergedArchives;
+	MergeGovernor m_MergeGovernor;
+	StagingManager m_StagingManager;
+	uint64_t m_InMemoryMergeLimit{};
+	std::shared_ptr<EntryCodec> m_EntryCodec;
+	std::unique_ptr<ARCToolBatcher> m_ARCToolBatcher;
+	std::atomic<CompressionProfile> m_CompressionProfile{ CompressionProfile::Default };
+	CompressionProfile m_MergeCompressionProfile{ CompressionProfile::Default }; // what the running merge uses
+
 	std::string m_ModFolderPath;
 	std::string m_ARCToolScriptPath;
+	std::string m_TraceFilePath;
 	std::string m_OutputFolderPath;
 	std::string m_SearchFolderPath;
 };
@@ -91,33 +177,30 @@ private:
 
 
 template<typename T, typename U>
-inline std::future<void> ModMerger::UnpackAsync(T&& sourcePath, U&& targetPath)
+inline std::future<bool> ModMerger::UnpackAsync(T&& sourcePath, U&& targetPath)
 {
 	auto copyAndUnpack = [
 		lsourcePath = std::forward<T>(sourcePath),
-			ltargetPath = std::forward<U>(targetPath),
-			arctool = std::string_view(m_ARCToolScriptPath)]() -> void
+			ltargetPath = std::forward<U>(targetPath), this]() -> bool
 		{
-			MakeBackup(lsourcePath, ltargetPath);
-			const std::filesystem::path newBackupFilePath{ std::filesystem::path(ltargetPath) / std::filesystem::path(lsourcePath).filename() };
-			CallARCTool(newBackupFilePath.string(), arctool);
+			return Unpack(lsourcePath, ltargetPath);
 		};
 
 		return ThreadPool::Enqueue(copyAndUnpack);
 }
 
 template<typename T, typename U>
-inline void ModMerger::UnpackBarrier(T&& sourcePath, U&& targetPath, std::barrier<>& barrier)
+inline void ModMerger::UnpackBarrier(T&& sourcePath, U&& targetPath, std::barrier<>& barrier, std::atomic_bool& unpackFailed)
 {
 	auto copyAndUnpack = [
 		lsourcePath = std::forward<T>(sourcePath),
-			ltargetPath = std::forward<U>(targetPath),
-			arctool = std::string_view(m_ARCToolScriptPath), &barrier]() -> void
+			ltargetPath = std::forward<U>(targetPath), this, &barrier, &unpackFailed]() -> void
 		{
-			MakeBackup(std::string_view(lsourcePath), std::string_view(ltargetPath));
-			const std::filesystem::path newBackupFilePath{ std::filesystem::path(ltargetPath) / std::filesystem::path(lsourcePath).filename() };
-			CallARCTool(newBackupFilePath.string(), arctool);
-			barrier.arrive_and_wait();
+			if (!Unpack(std::string_view(lsourcePath), std::string_view(ltargetPath)))
+				unpackFailed.store(true, std::memory_order_relaxed);
+
+			// only the merge waits on the barrier, a worker that waited too could starve the unpacks still queued
+			static_cast<void>(barrier.arrive());
 		};
 
 		// I don't want to unpack 100 of files in 100 threads, so I'm using EnqueueDetach
@@ -0,0 +1,565 @@
+#include "ProcessRunner.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "Logger.h"
+#include "ThreadPoolMetrics.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	// how often a running tool is checked for a cancel or its deadline
+	constexpr auto WaitSlice{ std::chrono::milliseconds(50) };
+
+	// shown again as a warning when the tool fails, the rest is only in the debug log
+	constexpr size_t KeptOutputLineCount{ 8 };
+
+	struct ProcessSlots
+	{
+		std::mutex mutex;
+		std::condition_variable_any releaseCV;
+		uint32_t maxCount{ std::max(1u, std::thread::hardware_concurrency()) };
+		uint32_t runningCount{};
+	};
+
+	ProcessSlots& GetProcessSlots()
+	{
+		static ProcessSlots processSlots{};
+		return processSlots;
+	}
+
+	// One of the processes allowed to run at once, for as long as it lives
+	class ProcessSlot
+	{
+	public:
+
+		explicit ProcessSlot(std::stop_token stopToken)
+		{
+			auto& slots{ GetProcessSlots() };
+
+			std::unique_lock lock(slots.mutex);
+			m_Valid = slots.releaseCV.wait(lock, stopToken, [&slots]()
+				{
+					return slots.runningCount < slots.maxCount;
+				});
+
+			if (m_Valid)
+				slots.runningCount++;
+		}
+
+		~ProcessSlot()
+		{
+			if (!m_Valid)
+				return;
+
+			auto& slots{ GetProcessSlots() };
+			{
+				std::scoped_lock lock(slots.mutex);
+				slots.runningCount--;
+			}
+
+			slots.releaseCV.notify_one();
+		}
+
+		ProcessSlot(const ProcessSlot&) = delete;
+		ProcessSlot& operator=(const ProcessSlot&) = delete;
+
+		bool IsValid() const { return m_Valid; }
+
+	private:
+
+		bool m_Valid{};
+	};
+
+	// Cuts what the tool prints into lines and logs each one as soon as it's complete
+	class OutputLog
+	{
+	public:
+
+		explicit OutputLog(std::string_view logName)
+			: m_LogName(logName)
+		{
+		}
+
+		void Append(const char* data, size_t size)
+		{
+			m_Pending.append(data, size);
+
+			size_t lineStart{};
+			for (size_t lineEnd = m_Pending.find('\n'); lineEnd != std::string::npos; lineEnd = m_Pending.find('\n', lineStart))
+			{
+				AddLine(std::string_view(m_Pending).substr(lineStart, lineEnd - lineStart));
+				lineStart = lineEnd + 1;
+			}
+
+			m_Pending.erase(0, lineStart);
+		}
+
+		// The last line may not end with a new line
+		void Flush()
+		{
+			AddLine(m_Pending);
+			m_Pending.clear();
+		}
+
+		void LogLastLines(LogLevel level) const
+		{
+			for (const auto& line : m_LastLines)
+			{
+				Logger::Log(level, m_LogName, ": ", line);
+			}
+		}
+
+	private:
+
+		void AddLine(std::string_view line)
+		{
+			// Windows tools end their lines with \r\n
+			while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+			{
+				line.remove_suffix(1);
+			}
+
+			if (line.empty())
+				return;
+
+			Logger::Debug(m_LogName, ": ", line);
+
+			m_LastLines.emplace_back(line);
+			if (m_LastLines.size() > KeptOutputLineCount)
+				m_LastLines.pop_front();
+		}
+
+		std::string_view m_LogName;
+		std::string m_Pending;
+		std::deque<std::string> m_LastLines;
+	};
+
+#ifdef _WIN32
+
+	std::wstring ToWideString(std::string_view text)
+	{
+		const int wideLength{ MultiByteToWideChar(CP_UTF8, 0, text.data(), int(text.size()), nullptr, 0) };
+		std::wstring wideText(size_t(wideLength), L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, text.data(), int(text.size()), wideText.data(), wideLength);
+		return wideText;
+	}
+
+	// Quoted the way CommandLineToArgvW splits it again, paths with spaces stay one argument
+	std::wstring BuildCommandLine(const std::vector<std::string>& args)
+	{
+		std::wstring commandLine{};
+		for (const auto& arg : args)
+		{
+			if (!commandLine.empty())
+				commandLine += L' ';
+
+			const std::wstring wideArg{ ToWideString(arg) };
+			if (!wideArg.empty() && wideArg.find_first_of(L" \t\"") == std::wstring::npos)
+			{
+				commandLine += wideArg;
+				continue;
+			}
+
+			commandLine += L'"';
+			size_t backslashCount{};
+			for (const wchar_t c : wideArg)
+			{
+				if (c == L'\\')
+				{
+					backslashCount++;
+					continue;
+				}
+
+				// backslashes only escape when a quote follows them
+				commandLine.append(c == L'"' ? backslashCount * 2 + 1 : backslashCount, L'\\');
+				commandLine += c;
+				backslashCount = 0;
+			}
+
+			commandLine.append(backslashCount * 2, L'\\');
+			commandLine += L'"';
+		}
+
+		return commandLine;
+	}
+
+	ProcessRunner::Result RunProcess(
+		const std::vector<std::string>& args,
+		Clock::time_point deadline,
+		OutputLog& output,
+		std::stop_token stopToken)
+	{
+		ProcessRunner::Result result{};
+
+		SECURITY_ATTRIBUTES inheritable{ sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+
+		// big enough that a chatty tool doesn't stall between two reads
+		HANDLE readPipe{};
+		HANDLE writePipe{};
+		if (!CreatePipe(&readPipe, &writePipe, &inheritable, 64 * 1024))
+		{
+			Logger::Error("Can't create a pipe for ", args[0], " (", GetLastError(), ")");
+			return result;
+		}
+
+		SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+
+		// nothing to read, a tool that waits for a key press at the end goes on right away
+		HANDLE nullInput{ CreateFileW(L"NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, nullptr) };
+
+		STARTUPINFOW si{ sizeof(si) };
+		si.dwFlags = STARTF_USESTDHANDLES;
+		si.hStdInput = nullInput;
+		si.hStdOutput = writePipe;
+		si.hStdError = writePipe;
+
+		// CreateProcess may write into the command line, it can't be const
+		std::wstring commandLine{ BuildCommandLine(args) };
+
+		// everything the tool starts goes into the job too, closing the job kills all of it
+		HANDLE job{ CreateJobObjectW(nullptr, nullptr) };
+		if (job)
+		{
+			JOBOBJECT_EXTENDED_LIMIT_INFORMATION jobLimits{};
+			jobLimits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+			SetInformationJobObject(job, JobObjectExtendedLimitInformation, &jobLimits, sizeof(jobLimits));
+		}
+
+		// suspended until it's in the job, it can't start anything outside of it
+		PROCESS_INFORMATION pi{};
+		const BOOL created{ CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW | CREATE_SUSPENDED, nullptr, nullptr, &si, &pi) };
+		const DWORD createError{ GetLastError() };
+
+		// only the child keeps the write end, the pipe ends when it does
+		CloseHandle(writePipe);
+		if (nullInput != INVALID_HANDLE_VALUE)
+			CloseHandle(nullInput);
+
+		if (!created)
+		{
+			Logger::Error("CreateProcess failed for ", args[0], " (", createError, ")");
+			CloseHandle(readPipe);
+			if (job)
+				CloseHandle(job);
+
+			return result;
+		}
+
+		if (job && !AssignProcessToJobObject(job, pi.hProcess))
+		{
+			Logger::Warning("Can't put ", args[0], " in a job (", GetLastError(), "), what it starts outlives a kill");
+			CloseHandle(job);
+			job = nullptr;
+		}
+
+		ResumeThread(pi.hThread);
+		CloseHandle(pi.hThread);
+		result.started = true;
+
+		std::array<char, 4096> buffer;
+		auto readAvailable = [&]()
+			{
+				DWORD available{};
+				while (PeekNamedPipe(readPipe, nullptr, 0, nullptr, &available, nullptr) && available > 0)
+				{
+					DWORD bytesRead{};
+					if (!ReadFile(readPipe, buffer.data(), std::min(available, DWORD(buffer.size())), &bytesRead, nullptr) || bytesRead == 0)
+						break;
+
+					output.Append(buffer.data(), bytesRead);
+				}
+			};
+
+		bool exited{};
+		while (!exited)
+		{
+			readAvailable();
+
+			if (stopToken.stop_requested())
+			{
+				result.cancelled = true;
+				break;
+			}
+
+			if (Clock::now() >= deadline)
+			{
+				result.timedOut = true;
+				break;
+			}
+
+			exited = WaitForSingleObject(pi.hProcess, DWORD(WaitSlice.count())) == WAIT_OBJECT_0;
+		}
+
+		readAvailable();
+
+		if (!exited)
+		{
+			if (job)
+				TerminateJobObject(job, 1);
+
+			if (!TerminateProcess(pi.hProcess, 1))
+			{
+				Logger::Error("Failed to terminate ", args[0], " (", GetLastError(), ")");
+			}
+			else
+			{
+				// let go of its files before staging cleans them up
+				WaitForSingleObject(pi.hProcess, 1000);
+			}
+		}
+
+		DWORD exitCode{};
+		if (GetExitCodeProcess(pi.hProcess, &exitCode))
+			result.exitCode = int(exitCode);
+
+		CloseHandle(pi.hProcess);
+		CloseHandle(readPipe);
+
+		// whatever the tool left running goes with it
+		if (job)
+			CloseHandle(job);
+
+		return result;
+	}
+
+#else
+
+	ProcessRunner::Result RunProcess(
+		const std::vector<std::string>& args,
+		Clock::time_point deadline,
+		OutputLog& output,
+		std::stop_token stopToken)
+	{
+		ProcessRunner::Result result{};
+
+		// close on exec, the child only gets the write end as its stdout and stderr
+		int pipeFds[2]{};
+		if (pipe2(pipeFds, O_CLOEXEC) != 0)
+		{
+			const int error{ errno };
+			Logger::Error("Can't create a pipe for ", args[0], ": ", std::strerror(error));
+			return result;
+		}
+
+		posix_spawn_file_actions_t fileActions;
+		posix_spawn_file_actions_init(&fileActions);
+		posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+		posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDOUT_FILENO);
+		posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDERR_FILENO);
+
+		// a process group of its own, killing it takes everything it started along (wine starts a few)
+		posix_spawnattr_t attributes;
+		posix_spawnattr_init(&attributes);
+		posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+		posix_spawnattr_setpgroup(&attributes, 0);
+
+		std::vector<char*> argv{};
+		argv.reserve(args.size() + 1);
+		for (const auto& arg : args)
+		{
+			argv.emplace_back(const_cast<char*>(arg.c_str()));
+		}
+
+		argv.emplace_back(nullptr);
+
+		pid_t pid{};
+		const int spawnError{ posix_spawnp(&pid, argv[0], &fileActions, &attributes, argv.data(), environ) };
+
+		posix_spawnattr_destroy(&attributes);
+		posix_spawn_file_actions_destroy(&fileActions);
+
+		// only the child keeps the write end, the pipe ends when it does
+		close(pipeFds[1]);
+
+		if (spawnError != 0)
+		{
+			Logger::Error("Can't start ", args[0], ": ", std::strerror(spawnError));
+			close(pipeFds[0]);
+			return result;
+		}
+
+		result.started = true;
+
+		int readFd{ pipeFds[0] };
+		std::array<char, 4096> buffer;
+
+		int status{};
+		bool exited{};
+		while (!exited)
+		{
+			if (stopToken.stop_requested())
+			{
+				result.cancelled = true;
+				break;
+			}
+
+			if (Clock::now() >= deadline)
+			{
+				result.timedOut = true;
+				break;
+			}
+
+			if (readFd >= 0)
+			{
+				pollfd pollFd{ readFd, POLLIN, 0 };
+				if (poll(&pollFd, 1, int(WaitSlice.count())) > 0)
+				{
+					const ssize_t length{ read(readFd, buffer.data(), buffer.size()) };
+					if (length > 0)
+					{
+						output.Append(buffer.data(), size_t(length));
+					}
+					else if (length == 0 || (errno != EINTR && errno != EAGAIN))
+					{
+						close(readFd);
+						readFd = -1;
+					}
+				}
+			}
+			else
+			{
+				std::this_thread::sleep_for(WaitSlice);
+			}
+
+			const pid_t waitResult{ waitpid(pid, &status, WNOHANG) };
+			exited = waitResult == pid || (waitResult < 0 && errno != EINTR);
+		}
+
+		if (!exited)
+		{
+			kill(-pid, SIGKILL);
+			while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+			{
+			}
+		}
+
+		if (readFd >= 0)
+		{
+			// whatever is left, without waiting on something it started that still holds the pipe
+			fcntl(readFd, F_SETFL, fcntl(readFd, F_GETFL) | O_NONBLOCK);
+
+			ssize_t length{};
+			while ((length = read(readFd, buffer.data(), buffer.size())) > 0)
+			{
+				output.Append(buffer.data(), size_t(length));
+			}
+
+			close(readFd);
+		}
+
+		if (WIFEXITED(status))
+		{
+			result.exitCode = WEXITSTATUS(status);
+		}
+		else if (WIFSIGNALED(status))
+		{
+			// the way shells report it
+			result.exitCode = 128 + WTERMSIG(status);
+		}
+
+		return result;
+	}
+
+#endif
+}
+
+void ProcessRunner::SetMaxProcesses(uint32_t count)
+{
+	auto& slots{ GetProcessSlots() };
+	{
+		std::scoped_lock lock(slots.mutex);
+		slots.maxCount = std::max(1u, count);
+	}
+
+	slots.releaseCV.notify_all();
+}
+
+uint32_t ProcessRunner::GetMaxProcesses()
+{
+	auto& slots{ GetProcessSlots() };
+	std::scoped_lock lock(slots.mutex);
+	return slots.maxCount;
+}
+
+uint32_t ProcessRunner::GetRunningCount()
+{
+	auto& slots{ GetProcessSlots() };
+	std::scoped_lock lock(slots.mutex);
+	return slots.runningCount;
+}
+
+ProcessRunner::Result ProcessRunner::Run(
+	const std::vector<std::string>& args,
+	std::chrono::milliseconds timeout,
+	std::string_view logName,
+	std::stop_token stopToken)
+{
+	Result result{};
+	if (args.empty())
+		return result;
+
+	// the worker only waits from here on, for a slot and then for the tool
+	const ThreadPoolMetrics::BlockScope blockScope{};
+
+	const ProcessSlot slot{ stopToken };
+	if (!slot.IsValid())
+	{
+		result.cancelled = true;
+		return result;
+	}
+
+	OutputLog output{ logName };
+
+	const auto startTime{ Clock::now() };
+	result = RunProcess(args, startTime + timeout, output, stopToken);
+	result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startTime);
+
+	output.Flush();
+
+	if (!result.started)
+		return result;
+
+	if (result.cancelled)
+	{
+		Logger::Debug(logName, " was stopped after ", result.duration.count(), " ms");
+	}
+	else if (result.timedOut)
+	{
+		output.LogLastLines(LogLevel::Warning);
+		Logger::Error(logName, " was killed after running for ", std::chrono::duration_cast<std::chrono::seconds>(timeout).count(), " s");
+	}
+	else if (result.exitCode != 0)
+	{
+		output.LogLastLines(LogLevel::Warning);
+		Logger::Error(logName, " exited with code ", result.exitCode, " after ", result.duration.count(), " ms");
+	}
+	else
+	{
+		Logger::Debug(logName, " finished in ", result.duration.count(), " ms");
+	}
+
+	return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// Runs external tools like ARCTool without a console window of their own.
+/// What a tool prints goes line by line into the log while it runs, how many tools run at once is capped
+/// and each one is killed when it runs past its timeout or the caller cancels.
+/// posix_spawn with a pipe on Linux, CreateProcess with a pipe on Windows
+/// </summary>
+class ProcessRunner
+{
+public:
+
+	struct Result
+	{
+		bool started{};
+		bool timedOut{};
+		bool cancelled{};
+		int exitCode{ -1 };
+		std::chrono::milliseconds duration{};
+
+		bool Succeeded() const { return started && !timedOut && !cancelled && exitCode == 0; }
+	};
+
+	// A Run past this many waits for one of the others to finish
+	static void SetMaxProcesses(uint32_t count);
+	static uint32_t GetMaxProcesses();
+	static uint32_t GetRunningCount();
+
+	// args[0] is searched in PATH when it isn't a path. Every line the tool prints is logged as "<logName>: <line>"
+	static Result Run(
+		const std::vector<std::string>& args,
+		std::chrono::milliseconds timeout,
+		std::string_view logName,
+		std::stop_token stopToken = {});
+};
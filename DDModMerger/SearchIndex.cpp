@@ -0,0 +1,291 @@
+#include "SearchIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <tuple>
+
+#include "FrameScheduler.h"
+#include "ThreadPool.h"
+#include "utils.h"
+
+namespace
+{
+	// share at least this much of the query's trigrams to show up as a fuzzy match
+	constexpr double FuzzyMatchRatio{ 0.6 };
+
+	std::string ToLower(std::string_view text)
+	{
+		std::string lowerText(text.size(), '\0');
+		std::transform(text.begin(), text.end(), lowerText.begin(), [](char c)
+			{
+				return char(std::tolower(static_cast<unsigned char>(c)));
+			});
+
+		return lowerText;
+	}
+
+	std::string_view Trim(std::string_view text)
+	{
+		while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+			text.remove_prefix(1);
+
+		while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+			text.remove_suffix(1);
+
+		return text;
+	}
+}
+
+SearchIndex::SearchIndex()
+	: m_State(std::make_shared<State>())
+{
+}
+
+void SearchIndex::BuildAsync(
+	const powe::details::DirectoryTree& dirTree,
+	const powe::details::ModsOverwriteOrder& overwriteOrder,
+	std::string_view searchFolderPath,
+	std::string_view modsFolderPath)
+{
+	uint64_t version{};
+	{
+		std::scoped_lock lock(m_State->mutex);
+		version = ++m_State->requestedVersion;
+	}
+
+	// the task gets its own copies, the UI can refresh again while it runs
+	auto build = [state = m_State, version, dirTree, overwriteOrder,
+		searchFolderPath = std::string(searchFolderPath), modsFolderPath = std::string(modsFolderPath)]()
+		{
+			std::vector<Snapshot::Document> documents{};
+			documents.reserve(dirTree.size());
+
+			for (const auto& [fileName, filePath] : dirTree)
+			{
+				Snapshot::Document document{};
+				document.fileName = fileName;
+
+				std::string_view relativePath{ filePath };
+				if (relativePath.size() > searchFolderPath.size() && relativePath.starts_with(searchFolderPath))
+					relativePath.remove_prefix(searchFolderPath.size() + 1);
+
+				document.relativePath = relativePath;
+				std::replace(document.relativePath.begin(), document.relativePath.end(), '\\', '/');
+
+				document.searchText = ToLower(document.fileName) + '\n' + ToLower(document.relativePath);
+
+				if (const auto findItr = overwriteOrder.find(fileName); findItr != overwriteOrder.end())
+				{
+					document.modCount = uint32_t(findItr->second.size());
+					for (const auto& modPath : findItr->second)
+					{
+						document.searchText += '\n' + ToLower(GetModName(modsFolderPath, modPath));
+					}
+				}
+
+				documents.emplace_back(std::move(document));
+			}
+
+			// the same order every time so the results don't jump around between refreshes
+			std::sort(documents.begin(), documents.end(), [](const Snapshot::Document& lhs, const Snapshot::Document& rhs)
+				{
+					return lhs.fileName < rhs.fileName;
+				});
+
+			auto snapshot{ std::make_shared<const Snapshot>(std::move(documents)) };
+
+			{
+				std::scoped_lock lock(state->mutex);
+
+				// a newer build could have finished first
+				if (version > state->builtVersion)
+				{
+					state->snapshot = std::move(snapshot);
+					state->builtVersion = version;
+				}
+			}
+
+			FrameScheduler::Wake();
+		};
+
+	ThreadPool::EnqueueDetach(std::move(build));
+}
+
+bool SearchIndex::IsBuilding() const
+{
+	std::scoped_lock lock(m_State->mutex);
+	return m_State->builtVersion < m_State->requestedVersion;
+}
+
+std::shared_ptr<const SearchIndex::Snapshot> SearchIndex::GetSnapshot() const
+{
+	std::scoped_lock lock(m_State->mutex);
+	return m_State->snapshot;
+}
+
+SearchIndex::Snapshot::Snapshot(std::vector<Document>&& documents)
+	: m_Documents(std::move(documents))
+{
+	std::vector<uint32_t> trigrams{};
+
+	for (uint32_t documentId = 0; documentId < uint32_t(m_Documents.size()); documentId++)
+	{
+		const std::string& searchText{ m_Documents[documentId].searchText };
+
+		trigrams.clear();
+		for (size_t i = 0; i + 2 < searchText.size(); i++)
+		{
+			trigrams.emplace_back(GetTrigram(searchText[i], searchText[i + 1], searchText[i + 2]));
+		}
+
+		std::sort(trigrams.begin(), trigrams.end());
+		trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+		// ids go up so every posting list stays sorted
+		for (const uint32_t trigram : trigrams)
+		{
+			m_Postings[trigram].emplace_back(documentId);
+		}
+	}
+}
+
+std::vector<SearchIndex::Result> SearchIndex::Snapshot::Query(std::string_view query, size_t maxResults) const
+{
+	const std::string lowerQuery{ ToLower(Trim(query)) };
+	if (lowerQuery.empty() || maxResults == 0)
+		return {};
+
+	// where the query is and how long the name is, a hit in the name comes first
+	using ExactRank = std::tuple<bool, size_t, size_t, uint32_t>;
+	std::vector<ExactRank> exactMatches{};
+
+	auto addIfExact = [this, &lowerQuery, &exactMatches](uint32_t documentId, bool nameOnly)
+		{
+			const Document& document{ m_Documents[documentId] };
+			const std::string_view searchText{ nameOnly ?
+				std::string_view(document.searchText).substr(0, document.fileName.size()) : std::string_view(document.searchText) };
+
+			const size_t position{ searchText.find(lowerQuery) };
+			if (position == std::string::npos)
+				return false;
+
+			exactMatches.emplace_back(position >= document.fileName.size(), position, document.fileName.size(), documentId);
+			return true;
+		};
+
+	std::vector<std::pair<uint32_t, uint32_t>> fuzzyMatches{}; // shared trigrams, document id
+
+	if (lowerQuery.size() < 3)
+	{
+		// too short for a trigram, a scan over the names is cheap enough. Paths and mods would match nearly everything
+		for (uint32_t documentId = 0; documentId < uint32_t(m_Documents.size()); documentId++)
+		{
+			addIfExact(documentId, true);
+		}
+	}
+	else
+	{
+		std::vector<uint32_t> queryTrigrams{};
+		for (size_t i = 0; i + 2 < lowerQuery.size(); i++)
+		{
+			queryTrigrams.emplace_back(GetTrigram(lowerQuery[i], lowerQuery[i + 1], lowerQuery[i + 2]));
+		}
+
+		std::sort(queryTrigrams.begin(), queryTrigrams.end());
+		queryTrigrams.erase(std::unique(queryTrigrams.begin(), queryTrigrams.end()), queryTrigrams.end());
+
+		std::vector<const std::vector<uint32_t>*> postingLists{};
+		bool hasEveryTrigram{ true };
+		for (const uint32_t trigram : queryTrigrams)
+		{
+			if (const auto findItr = m_Postings.find(trigram); findItr != m_Postings.end())
+				postingLists.emplace_back(&findItr->second);
+			else
+				hasEveryTrigram = false;
+		}
+
+		// a substring has every trigram of the query, intersect starting from the rarest
+		if (hasEveryTrigram)
+		{
+			std::sort(postingLists.begin(), postingLists.end(), [](const auto* lhs, const auto* rhs)
+				{
+					return lhs->size() < rhs->size();
+				});
+
+			std::vector<uint32_t> candidates{ *postingLists.front() };
+			std::vector<uint32_t> intersection{};
+			for (size_t i = 1; i < postingLists.size() && !candidates.empty(); i++)
+			{
+				intersection.clear();
+				std::set_intersection(candidates.begin(), candidates.end(),
+					postingLists[i]->begin(), postingLists[i]->end(), std::back_inserter(intersection));
+				std::swap(candidates, intersection);
+			}
+
+			// sharing every trigram doesn't mean they're next to each other
+			for (const uint32_t documentId : candidates)
+			{
+				addIfExact(documentId, false);
+			}
+		}
+
+		if (exactMatches.size() < maxResults)
+		{
+			std::vector<uint16_t> sharedCounts(m_Documents.size());
+			for (const auto* postingList : postingLists)
+			{
+				for (const uint32_t documentId : *postingList)
+				{
+					sharedCounts[documentId]++;
+				}
+			}
+
+			// exact ones are already in
+			for (const auto& exactMatch : exactMatches)
+			{
+				sharedCounts[std::get<3>(exactMatch)] = 0;
+			}
+
+			const uint32_t minSharedCount{ std::max<uint32_t>(1, uint32_t(double(queryTrigrams.size()) * FuzzyMatchRatio + 0.5)) };
+			for (uint32_t documentId = 0; documentId < uint32_t(sharedCounts.size()); documentId++)
+			{
+				if (sharedCounts[documentId] >= minSharedCount)
+					fuzzyMatches.emplace_back(sharedCounts[documentId], documentId);
+			}
+
+			std::stable_sort(fuzzyMatches.begin(), fuzzyMatches.end(), [](const auto& lhs, const auto& rhs)
+				{
+					return lhs.first > rhs.first;
+				});
+		}
+	}
+
+	const size_t exactResultCount{ std::min(maxResults, exactMatches.size()) };
+	std::partial_sort(exactMatches.begin(), exactMatches.begin() + exactResultCount, exactMatches.end());
+
+	std::vector<Result> results{};
+	results.reserve(std::min(maxResults, exactMatches.size() + fuzzyMatches.size()));
+
+	auto addResult = [this, &results](uint32_t documentId, bool exact)
+		{
+			const Document& document{ m_Documents[documentId] };
+			results.emplace_back(Result{ &document.fileName, &document.relativePath, document.modCount, exact });
+		};
+
+	for (size_t i = 0; i < exactResultCount; i++)
+	{
+		addResult(std::get<3>(exactMatches[i]), true);
+	}
+
+	for (size_t i = 0; i < fuzzyMatches.size() && results.size() < maxResults; i++)
+	{
+		addResult(fuzzyMatches[i].second, false);
+	}
+
+	return results;
+}
+
+uint32_t SearchIndex::Snapshot::GetTrigram(char a, char b, char c)
+{
+	return (uint32_t(uint8_t(a)) << 16) | (uint32_t(uint8_t(b)) << 8) | uint32_t(uint8_t(c));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Types.h"
+
+/// <summary>
+/// Trigram index over every archive of the install, its path under the search folder
+/// and the mods that overwrite it. Built on the thread pool after a refresh,
+/// the old index keeps answering until the new one is done.
+/// A query is a case insensitive substring search, then a fuzzy one on the trigrams it shares with archives
+/// so a typo still finds something
+/// </summary>
+class SearchIndex
+{
+public:
+
+	struct Result
+	{
+		const std::string* fileName{};
+		const std::string* relativePath{};
+		uint32_t modCount{};
+		bool exact{}; // the query is a substring, otherwise it only shares enough trigrams
+	};
+
+	// The strings the results point to live as long as this
+	class Snapshot;
+
+	SearchIndex();
+
+	void BuildAsync(
+		const powe::details::DirectoryTree& dirTree,
+		const powe::details::ModsOverwriteOrder& overwriteOrder,
+		std::string_view searchFolderPath,
+		std::string_view modsFolderPath);
+
+	bool IsBuilding() const;
+
+	// nullptr until the first build is done
+	std::shared_ptr<const Snapshot> GetSnapshot() const;
+
+private:
+
+	struct State
+	{
+		mutable std::mutex mutex;
+		std::shared_ptr<const Snapshot> snapshot;
+		uint64_t requestedVersion{};
+		uint64_t builtVersion{};
+	};
+
+	std::shared_ptr<State> m_State;
+};
+
+class SearchIndex::Snapshot
+{
+public:
+
+	struct Document
+	{
+		std::string fileName;
+		std::string relativePath;
+		std::string searchText; // lower case name, path and mod names, one per line
+		uint32_t modCount{};
+	};
+
+	explicit Snapshot(std::vector<Document>&& documents);
+
+	// Exact matches first (the ones that hit the name before the ones that only hit a path or a mod),
+	// fuzzy ones after them by how many trigrams they share with the query
+	std::vector<Result> Query(std::string_view query, size_t maxResults) const;
+
+	size_t GetDocumentCount() const { return m_Documents.size(); }
+
+private:
+
+	static uint32_t GetTrigram(char a, char b, char c);
+
+	std::vector<Document> m_Documents;
+
+	// document ids in ascending order per trigram
+	std::unordered_map<uint32_t, std::vector<uint32_t>> m_Postings;
+};
@@ -0,0 +1,222 @@
+#include "StagingManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+
+#include "Tracer.h"
+#include "Logger.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr char TrashFolderName[] = ".trash";
+	constexpr char WorkspacePrefix[] = "ws";
+
+	// Only folders we made get cleaned up, -staging could point somewhere the user keeps other things
+	bool IsWorkspaceName(const std::string& name)
+	{
+		const std::string_view prefix{ WorkspacePrefix };
+		return name.size() > prefix.size() && name.starts_with(prefix)
+			&& std::all_of(name.begin() + prefix.size(), name.end(), [](char c) { return c >= '0' && c <= '9'; });
+	}
+
+	void LowerCurrentThreadPriority()
+	{
+#ifdef _WIN32
+		// background mode lowers the I/O priority too, not just the CPU
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+		// on Linux the nice value of PRIO_PROCESS 0 only applies to the calling thread
+		setpriority(PRIO_PROCESS, 0, 19);
+#endif
+	}
+}
+
+StagingManager::Workspace::Workspace(StagingManager* manager, fs::path path)
+	: m_Manager(manager)
+	, m_Path(std::move(path))
+{
+}
+
+StagingManager::Workspace::Workspace(Workspace&& other) noexcept
+	: m_Manager(std::exchange(other.m_Manager, nullptr))
+	, m_Path(std::move(other.m_Path))
+{
+}
+
+StagingManager::Workspace& StagingManager::Workspace::operator=(Workspace&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (m_Manager)
+			m_Manager->Release(m_Path);
+
+		m_Manager = std::exchange(other.m_Manager, nullptr);
+		m_Path = std::move(other.m_Path);
+	}
+
+	return *this;
+}
+
+StagingManager::Workspace::~Workspace()
+{
+	if (m_Manager)
+		m_Manager->Release(m_Path);
+}
+
+StagingManager::StagingManager(fs::path rootPath)
+	: m_RootPath(std::move(rootPath))
+	, m_TrashPath(m_RootPath / TrashFolderName)
+	, m_TrashPrefix(uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()))
+{
+	std::error_code errorCode{};
+	fs::create_directories(m_TrashPath, errorCode);
+	if (errorCode)
+	{
+		Logger::Error("Can't create staging folder ", m_TrashPath, ": ", errorCode.message());
+	}
+
+	// Whatever an earlier run left behind goes to the background thread too
+	for (const auto& entry : fs::directory_iterator(m_TrashPath, errorCode))
+	{
+		m_CleanupQueue.emplace_back(entry.path());
+		m_PendingCleanupCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::vector<fs::path> leftovers{};
+	for (const auto& entry : fs::directory_iterator(m_RootPath, errorCode))
+	{
+		if (entry.is_directory(errorCode) && IsWorkspaceName(entry.path().filename().string()))
+			leftovers.emplace_back(entry.path());
+	}
+
+	for (const auto& leftover : leftovers)
+	{
+		Discard(leftover);
+	}
+
+	m_CleanupThread = std::jthread([this](std::stop_token stopToken) { CleanupLoop(stopToken); });
+}
+
+StagingManager::~StagingManager()
+{
+	// Whatever is still queued stays in the trash folder and gets picked up on the next start
+	m_CleanupThread.request_stop();
+	m_CleanupCV.notify_all();
+}
+
+StagingManager::Workspace StagingManager::Acquire()
+{
+	fs::path workspacePath{};
+
+	{
+		std::scoped_lock lock(m_WorkspaceMutex);
+		if (!m_FreeWorkspaces.empty())
+		{
+			workspacePath = std::move(m_FreeWorkspaces.back());
+			m_FreeWorkspaces.pop_back();
+		}
+		else
+		{
+			workspacePath = m_RootPath / (WorkspacePrefix + std::to_string(m_NextWorkspaceId++));
+		}
+	}
+
+	fs::create_directories(workspacePath);
+
+	return Workspace{ this, std::move(workspacePath) };
+}
+
+void StagingManager::Release(const fs::path& workspacePath)
+{
+	// Renames are cheap, the actual deleting happens on the cleanup thread.
+	// The folders right under the workspace stay, the next archive usually unpacks the same mods into them
+	std::vector<fs::path> leftovers{};
+	std::error_code errorCode{};
+	for (const auto& entry : fs::directory_iterator(workspacePath, errorCode))
+	{
+		if (!entry.is_directory(errorCode))
+		{
+			leftovers.emplace_back(entry.path());
+			continue;
+		}
+
+		for (const auto& payload : fs::directory_iterator(entry.path(), errorCode))
+		{
+			leftovers.emplace_back(payload.path());
+		}
+	}
+
+	for (const auto& leftover : leftovers)
+	{
+		Discard(leftover);
+	}
+
+	std::scoped_lock lock(m_WorkspaceMutex);
+	m_FreeWorkspaces.emplace_back(workspacePath);
+}
+
+void StagingManager::Discard(const fs::path& path)
+{
+	const fs::path trashPath{ m_TrashPath /
+		(std::to_string(m_TrashPrefix) + '-' + std::to_string(m_TrashCounter.fetch_add(1, std::memory_order_relaxed))) };
+
+	std::error_code errorCode{};
+	fs::rename(path, trashPath, errorCode);
+	if (errorCode)
+	{
+		fs::remove_all(path, errorCode);
+		return;
+	}
+
+	{
+		std::scoped_lock lock(m_CleanupMutex);
+		m_CleanupQueue.emplace_back(trashPath);
+	}
+
+	m_PendingCleanupCount.fetch_add(1, std::memory_order_relaxed);
+	m_CleanupCV.notify_one();
+}
+
+void StagingManager::CleanupLoop(std::stop_token stopToken)
+{
+	LowerCurrentThreadPriority();
+
+	while (!stopToken.stop_requested())
+	{
+		fs::path pathToRemove{};
+
+		{
+			std::unique_lock lock(m_CleanupMutex);
+			if (!m_CleanupCV.wait(lock, stopToken, [this] { return !m_CleanupQueue.empty(); }))
+				return;
+
+			pathToRemove = std::move(m_CleanupQueue.front());
+			m_CleanupQueue.pop_front();
+		}
+
+		std::error_code errorCode{};
+		{
+			const Tracer::Scope traceScope{ "cleanup" };
+			fs::remove_all(pathToRemove, errorCode);
+		}
+		if (errorCode)
+		{
+			Logger::Error("Failed to clean up ", pathToRemove, ": ", errorCode.message());
+		}
+
+		m_PendingCleanupCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Hands out per-archive workspaces under one staging root (./mergeRoom by default, can be a tmpfs or a fast SSD).
+/// Workspace folders and the folders right under them are kept and reused, whatever was left in those is renamed into a trash folder
+/// and deleted by a low priority thread so the next archive never waits on the cleanup
+/// </summary>
+class StagingManager
+{
+public:
+
+	// Goes back to the pool when it goes out of scope
+	class Workspace
+	{
+	public:
+
+		Workspace() = default;
+		Workspace(StagingManager* manager, std::filesystem::path path);
+		Workspace(Workspace&& other) noexcept;
+		Workspace& operator=(Workspace&& other) noexcept;
+		~Workspace();
+
+		Workspace(const Workspace&) = delete;
+		Workspace& operator=(const Workspace&) = delete;
+
+		const std::filesystem::path& GetPath() const { return m_Path; }
+
+	private:
+
+		StagingManager* m_Manager{};
+		std::filesystem::path m_Path;
+	};
+
+	explicit StagingManager(std::filesystem::path rootPath);
+	~StagingManager();
+
+	StagingManager(const StagingManager&) = delete;
+	StagingManager& operator=(const StagingManager&) = delete;
+
+	// A folder for one archive, reuses a finished one when there is one. A reused one may still have empty folders in it
+	[[nodiscard]] Workspace Acquire();
+
+	const std::filesystem::path& GetRootPath() const { return m_RootPath; }
+
+	// Folders waiting for the background thread to delete them
+	uint32_t GetPendingCleanupCount() const { return m_PendingCleanupCount.load(std::memory_order_relaxed); }
+
+private:
+
+	void Release(const std::filesystem::path& workspacePath);
+
+	// rename into the trash folder and queue it, falls back to deleting right here if rename fails
+	void Discard(const std::filesystem::path& path);
+	void CleanupLoop(std::stop_token stopToken);
+
+	std::filesystem::path m_RootPath;
+	std::filesystem::path m_TrashPath;
+
+	std::mutex m_WorkspaceMutex;
+	std::vector<std::filesystem::path> m_FreeWorkspaces;
+	uint32_t m_NextWorkspaceId{};
+
+	std::mutex m_CleanupMutex;
+	std::condition_variable_any m_CleanupCV;
+	std::deque<std::filesystem::path> m_CleanupQueue;
+	std::atomic<uint32_t> m_PendingCleanupCount{};
+	std::atomic<uint64_t> m_TrashCounter{};
+	uint64_t m_TrashPrefix{};
+
+	// last so it's stopped and joined before anything it touches goes away
+	std::jthread m_CleanupThread;
+};
@@ -3,29 +3,22 @@
 #include <future>
 #include <iostream>
 #include "Types.h"
-#include "thread_pool/thread_pool.h"
+#include "WorkerPool.h"
 
 
 class ThreadPool
 {
 public:
 
-	using threadImpl = dp::thread_pool<std::function<void()>, std::jthread>;
-
+	// Resizes the pool in place, work that's queued or running carries on
 	static void Init(uint32_t threadCount)
 	{
-		auto& instance = ThreadPool::GetInstance();
-		auto& threadPool = instance.GetThreadPoolImpl();
-		if (threadPool->size() != threadCount)
-		{
-			threadPool = std::make_shared<threadImpl>(threadCount);
-		}
+		GetInstance().m_WorkerPool.Resize(threadCount);
 	}
 
 	static uint32_t Size()
 	{
-		auto& instance{ GetInstance() };
-		return static_cast<uint32_t>(instance.GetThreadPoolImpl()->size());
+		return GetInstance().m_WorkerPool.Size();
 	}
 	
 	template<typename T>
@@ -34,26 +27,32 @@ public:
 		return std::vector<std::future<T>>(Size() / 2);
 	}
 
+	static ThreadPoolMetrics::Snapshot GetMetrics()
+	{
+		return GetInstance().m_WorkerPool.GetMetrics();
+	}
+
+	static void ResetLatencies()
+	{
+		GetInstance().m_WorkerPool.ResetLatencies();
+	}
+
 	template<typename Func, typename... Args>
 	static std::future<std::invoke_result_t<Func, Args...>> Enqueue(Func&& func, Args&&... args)
 	{
-		auto& instance{ GetInstance() };
-		auto& threadPool{ instance.GetThreadPoolImpl() };
-		return threadPool->enqueue(std::forward<Func>(func), std::forward<Args>(args)...);
+		return GetInstance().m_WorkerPool.Enqueue(std::forward<Func>(func), std::forward<Args>(args)...);
 	}
 
 	template<typename Func, typename... Args>
 	static void EnqueueDetach(Func&& func, Args&&... args)
 	{
-		auto& instance{ GetInstance() };
-		auto& threadPool{ instance.GetThreadPoolImpl() };
-		threadPool->enqueue_detach(std::forward<Func>(func), std::forward<Args>(args)...);
+		GetInstance().m_WorkerPool.EnqueueDetach(std::forward<Func>(func), std::forward<Args>(args)...);
 	}
 
 private:
 
 	ThreadPool()
-		: m_ThreadPool(std::make_shared<threadImpl>(std::thread::hardware_concurrency()))
+		: m_WorkerPool(std::thread::hardware_concurrency())
 	{
 	}
 
@@ -66,8 +65,5 @@ private:
 		return threadPool;
 	}
 
-	std::shared_ptr<threadImpl>& GetThreadPoolImpl() { return m_ThreadPool; }
-
-	std::shared_ptr<threadImpl> m_ThreadPool;
+	WorkerPool m_WorkerPool;
 };
-
@@ -0,0 +1,129 @@
+#include "ThreadPoolMetrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+thread_local ThreadPoolMetrics* ThreadPoolMetrics::s_CurrentMetrics{};
+
+ThreadPoolMetrics::TaskScope::TaskScope(ThreadPoolMetrics& metrics, uint64_t submitTime)
+	: m_Metrics(metrics)
+	, m_PreviousMetrics(s_CurrentMetrics)
+	, m_StartTime(Now())
+{
+	m_Metrics.m_StartedCount.fetch_add(1, std::memory_order_relaxed);
+	m_Metrics.m_WaitTime.Add(m_StartTime - std::min(submitTime, m_StartTime));
+
+	s_CurrentMetrics = &m_Metrics;
+}
+
+ThreadPoolMetrics::TaskScope::~TaskScope()
+{
+	s_CurrentMetrics = m_PreviousMetrics;
+
+	m_Metrics.m_RunTime.Add(Now() - m_StartTime);
+	m_Metrics.m_CompletedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+ThreadPoolMetrics::BlockScope::BlockScope()
+	: m_Metrics(s_CurrentMetrics)
+{
+	if (m_Metrics)
+		m_Metrics->m_BlockedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+ThreadPoolMetrics::BlockScope::~BlockScope()
+{
+	if (m_Metrics)
+		m_Metrics->m_BlockedCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ThreadPoolMetrics::Snapshot ThreadPoolMetrics::GetSnapshot(uint32_t workerCount) const
+{
+	// read back to front so a task that moves on while we read never makes a count go negative
+	const uint64_t completedCount{ m_CompletedCount.load(std::memory_order_relaxed) };
+	const uint64_t startedCount{ std::max(completedCount, m_StartedCount.load(std::memory_order_relaxed)) };
+	const uint64_t submittedCount{ std::max(startedCount, m_SubmittedCount.load(std::memory_order_relaxed)) };
+	const uint64_t activeCount{ startedCount - completedCount };
+
+	Snapshot snapshot{};
+	snapshot.workerCount = workerCount;
+	snapshot.queueDepth = submittedCount - startedCount;
+	snapshot.activeCount = activeCount;
+	snapshot.blockedCount = std::min(activeCount, m_BlockedCount.load(std::memory_order_relaxed));
+	snapshot.completedCount = completedCount;
+	snapshot.meanWaitTime = m_WaitTime.GetMean();
+	snapshot.p99WaitTime = m_WaitTime.GetPercentile(0.99);
+	snapshot.meanRunTime = m_RunTime.GetMean();
+	snapshot.p99RunTime = m_RunTime.GetPercentile(0.99);
+
+	return snapshot;
+}
+
+void ThreadPoolMetrics::ResetLatencies()
+{
+	m_WaitTime.Reset();
+	m_RunTime.Reset();
+}
+
+uint64_t ThreadPoolMetrics::Now()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void ThreadPoolMetrics::LatencyHistogram::Add(uint64_t microseconds)
+{
+	// bucket n holds [2^(n-1), 2^n) microseconds, bucket 0 anything under 1us
+	const size_t bucket{ std::min<size_t>(std::bit_width(microseconds), BucketCount - 1) };
+
+	m_Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	m_TotalTime.fetch_add(microseconds, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadPoolMetrics::LatencyHistogram::Reset()
+{
+	for (auto& bucket : m_Buckets)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+
+	m_TotalTime.store(0, std::memory_order_relaxed);
+	m_Count.store(0, std::memory_order_relaxed);
+}
+
+double ThreadPoolMetrics::LatencyHistogram::GetMean() const
+{
+	const uint64_t count{ m_Count.load(std::memory_order_relaxed) };
+	if (count == 0)
+		return 0.0;
+
+	return double(m_TotalTime.load(std::memory_order_relaxed)) / double(count) / 1000.0;
+}
+
+double ThreadPoolMetrics::LatencyHistogram::GetPercentile(double percentile) const
+{
+	std::array<uint64_t, BucketCount> buckets{};
+	uint64_t count{};
+	for (size_t i = 0; i < BucketCount; i++)
+	{
+		buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+		count += buckets[i];
+	}
+
+	if (count == 0)
+		return 0.0;
+
+	const uint64_t rank{ std::max<uint64_t>(1, uint64_t(double(count) * percentile + 0.5)) };
+
+	uint64_t seen{};
+	for (size_t i = 0; i < BucketCount; i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return double(uint64_t(1) << i) / 1000.0;
+	}
+
+	return double(uint64_t(1) << (BucketCount - 1)) / 1000.0;
+}
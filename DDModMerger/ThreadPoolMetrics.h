@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+/// <summary>
+/// Counters a thread pool keeps about the work going through it.
+/// Everything is a relaxed atomic so the UI can take a snapshot every frame without touching the pool's lock.
+/// Latencies go into power of two buckets, the p99 is the upper edge of the bucket it falls in
+/// </summary>
+class ThreadPoolMetrics
+{
+public:
+
+	struct Snapshot
+	{
+		uint32_t workerCount{};
+		uint64_t queueDepth{}; // submitted but no worker picked it up yet
+		uint64_t activeCount{}; // running right now, blocked ones included
+		uint64_t blockedCount{}; // running but waiting on a barrier, a condition variable or another task
+		uint64_t completedCount{};
+
+		// milliseconds
+		double meanWaitTime{};
+		double p99WaitTime{};
+		double meanRunTime{};
+		double p99RunTime{};
+	};
+
+	// Lives on the worker for as long as the task runs
+	class TaskScope
+	{
+	public:
+
+		TaskScope(ThreadPoolMetrics& metrics, uint64_t submitTime);
+		~TaskScope();
+
+		TaskScope(const TaskScope&) = delete;
+		TaskScope& operator=(const TaskScope&) = delete;
+
+	private:
+
+		ThreadPoolMetrics& m_Metrics;
+		ThreadPoolMetrics* m_PreviousMetrics;
+		uint64_t m_StartTime;
+	};
+
+	// Marks the worker it's created on as blocked until it goes out of scope.
+	// Does nothing on a thread that isn't running a pool task
+	class BlockScope
+	{
+	public:
+
+		BlockScope();
+		~BlockScope();
+
+		BlockScope(const BlockScope&) = delete;
+		BlockScope& operator=(const BlockScope&) = delete;
+
+	private:
+
+		ThreadPoolMetrics* m_Metrics;
+	};
+
+	// Counts func as submitted now and returns it wrapped so running it is counted too
+	template<typename Func>
+	auto Track(Func&& func);
+
+	Snapshot GetSnapshot(uint32_t workerCount) const;
+
+	// Forget the latencies so far, the counters that describe the queue stay
+	void ResetLatencies();
+
+	// microseconds on a steady clock
+	static uint64_t Now();
+
+private:
+
+	class LatencyHistogram
+	{
+	public:
+
+		void Add(uint64_t microseconds);
+		void Reset();
+
+		double GetMean() const;
+		double GetPercentile(double percentile) const;
+
+	private:
+
+		static constexpr size_t BucketCount{ 32 };
+
+		std::array<std::atomic<uint64_t>, BucketCount> m_Buckets{};
+		std::atomic<uint64_t> m_Count{};
+		std::atomic<uint64_t> m_TotalTime{};
+	};
+
+	std::atomic<uint64_t> m_SubmittedCount{};
+	std::atomic<uint64_t> m_StartedCount{};
+	std::atomic<uint64_t> m_CompletedCount{};
+	std::atomic<uint64_t> m_BlockedCount{};
+
+	LatencyHistogram m_WaitTime;
+	LatencyHistogram m_RunTime;
+
+	// the pool whose task the current thread is running, if any
+	static thread_local ThreadPoolMetrics* s_CurrentMetrics;
+};
+
+template<typename Func>
+auto ThreadPoolMetrics::Track(Func&& func)
+{
+	m_SubmittedCount.fetch_add(1, std::memory_order_relaxed);
+
+	return [this, submitTime = Now(), lfunc = std::forward<Func>(func)](auto&&... args) -> decltype(auto)
+		{
+			const TaskScope taskScope{ *this, submitTime };
+			return std::invoke(lfunc, std::forward<decltype(args)>(args)...);
+		};
+}
@@ -0,0 +1,190 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "Logger.h"
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char* stage;
+		std::array<char, 64> archive; // same limit as a name in the ARC TOC
+		uint64_t startTime;
+		uint64_t endTime;
+		uint64_t bytes;
+	};
+
+	// Fixed size so a chunk never moves once the exporter can see it
+	struct TraceChunk
+	{
+		static constexpr size_t Capacity{ 1024 };
+
+		std::array<TraceEvent, Capacity> events;
+		std::atomic<size_t> count{};
+		std::atomic<TraceChunk*> next{};
+	};
+
+	// Only the owning thread writes, the exporter reads up to the published count
+	struct ThreadTraceBuffer
+	{
+		explicit ThreadTraceBuffer(uint32_t id)
+			: threadId(id)
+			, head(std::make_unique<TraceChunk>())
+			, tail(head.get())
+		{
+		}
+
+		~ThreadTraceBuffer()
+		{
+			TraceChunk* chunk{ head->next.load(std::memory_order_relaxed) };
+			while (chunk)
+			{
+				TraceChunk* next{ chunk->next.load(std::memory_order_relaxed) };
+				delete chunk;
+				chunk = next;
+			}
+		}
+
+		void Push(const TraceEvent& event)
+		{
+			size_t count{ tail->count.load(std::memory_order_relaxed) };
+			if (count == TraceChunk::Capacity)
+			{
+				TraceChunk* newChunk{ new TraceChunk() };
+				tail->next.store(newChunk, std::memory_order_release);
+				tail = newChunk;
+				count = 0;
+			}
+
+			tail->events[count] = event;
+			tail->count.store(count + 1, std::memory_order_release);
+		}
+
+		uint32_t threadId;
+		std::unique_ptr<TraceChunk> head;
+		TraceChunk* tail;
+	};
+
+	// Buffers live as long as the program so a thread that ended can still be exported
+	struct TraceRegistry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers;
+		const std::chrono::steady_clock::time_point startTime{ std::chrono::steady_clock::now() };
+	};
+
+	TraceRegistry& GetRegistry()
+	{
+		static TraceRegistry registry{};
+		return registry;
+	}
+
+	ThreadTraceBuffer& GetThreadBuffer()
+	{
+		// registering takes the lock once per thread, everything after is lock free
+		thread_local ThreadTraceBuffer* threadBuffer{ []()
+			{
+				auto& registry{ GetRegistry() };
+				std::scoped_lock lock(registry.mutex);
+				return registry.buffers.emplace_back(
+					std::make_unique<ThreadTraceBuffer>(uint32_t(registry.buffers.size() + 1))).get();
+			}() };
+
+		return *threadBuffer;
+	}
+}
+
+Tracer::Scope::Scope(const char* stage, std::string_view archive, uint64_t bytes)
+	: m_Stage(stage)
+	, m_Archive(archive)
+	, m_Bytes(bytes)
+{
+	if (IsEnabled())
+		m_StartTime = Now();
+}
+
+Tracer::Scope::~Scope()
+{
+	if (IsEnabled() && m_StartTime != 0)
+		Record(m_Stage, m_Archive, m_StartTime, Now(), m_Bytes);
+}
+
+uint64_t Tracer::Now()
+{
+	const auto elapsed{ std::chrono::steady_clock::now() - GetRegistry().startTime };
+
+	// 0 means "not started" for a scope
+	return std::max<uint64_t>(1, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+}
+
+void Tracer::Record(const char* stage, std::string_view archive, uint64_t startTime, uint64_t endTime, uint64_t bytes)
+{
+	if (!IsEnabled())
+		return;
+
+	TraceEvent event{ stage, {}, startTime, endTime, bytes };
+
+	// keep the end of the path, that's where the archive's name is
+	if (archive.size() >= event.archive.size())
+		archive = archive.substr(archive.size() - (event.archive.size() - 1));
+
+	std::copy(archive.begin(), archive.end(), event.archive.begin());
+
+	GetThreadBuffer().Push(event);
+}
+
+bool Tracer::Export(const std::filesystem::path& filePath)
+{
+	nlohmann::json traceEvents = nlohmann::json::array();
+
+	auto& registry{ GetRegistry() };
+	std::scoped_lock lock(registry.mutex);
+
+	for (const auto& buffer : registry.buffers)
+	{
+		traceEvents.push_back({
+			{ "name", "thread_name" },
+			{ "ph", "M" },
+			{ "pid", 1 },
+			{ "tid", buffer->threadId },
+			{ "args", { { "name", "worker " + std::to_string(buffer->threadId) } } } });
+
+		for (const TraceChunk* chunk{ buffer->head.get() }; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			const size_t count{ chunk->count.load(std::memory_order_acquire) };
+			for (size_t i = 0; i < count; i++)
+			{
+				const TraceEvent& event{ chunk->events[i] };
+
+				// Chrome wants microseconds
+				traceEvents.push_back({
+					{ "name", event.stage },
+					{ "cat", "merge" },
+					{ "ph", "X" },
+					{ "ts", double(event.startTime) / 1000.0 },
+					{ "dur", double(event.endTime - event.startTime) / 1000.0 },
+					{ "pid", 1 },
+					{ "tid", buffer->threadId },
+					{ "args", { { "archive", event.archive.data() }, { "bytes", event.bytes } } } });
+			}
+		}
+	}
+
+	std::ofstream outFile(filePath);
+	if (!outFile)
+	{
+		Logger::Error("Can't write trace to ", filePath);
+		return false;
+	}
+
+	outFile << nlohmann::json{ { "traceEvents", std::move(traceEvents) }, { "displayTimeUnit", "ms" } };
+	return outFile.good();
+}
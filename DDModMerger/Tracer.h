@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+/// <summary>
+/// Records how long each merge stage takes, on which thread and for which archive.
+/// Every thread appends to its own buffer so recording never takes a lock,
+/// Export writes everything recorded so far as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+/// Does nothing until it's enabled with -trace
+/// </summary>
+class Tracer
+{
+public:
+
+	// stage has to be a string literal, only the pointer is kept
+	class Scope
+	{
+	public:
+
+		Scope(const char* stage, std::string_view archive = {}, uint64_t bytes = 0);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		void SetBytes(uint64_t bytes) { m_Bytes = bytes; }
+
+	private:
+
+		const char* m_Stage;
+		std::string_view m_Archive;
+		uint64_t m_Bytes;
+		uint64_t m_StartTime{};
+	};
+
+	static void SetEnabled(bool enabled) { s_Enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+
+	static void Record(const char* stage, std::string_view archive, uint64_t startTime, uint64_t endTime, uint64_t bytes);
+
+	static bool Export(const std::filesystem::path& filePath);
+
+	// nanoseconds since the tracer started
+	static uint64_t Now();
+
+private:
+
+	static inline std::atomic_bool s_Enabled{};
+};
@@ -4,6 +4,9 @@
 #include <functional>
 #include <string>
 #include <thread>
+#include <future>
+#include <unordered_map>
+#include <vector>
 
 namespace dp
 {
@@ -20,5 +23,6 @@ namespace powe
 	{
 		using ModsOverwriteOrder = std::unordered_map<std::string, std::vector<std::string>>;
 		using DirectoryTree = std::unordered_map<std::string, std::string>;
+		using BackupFutures = std::unordered_map<std::string, std::shared_future<void>>;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(uint32_t workerCount)
+{
+	Resize(workerCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_Stopping = true;
+	}
+
+	m_TaskCV.notify_all();
+
+	// jthread joins on destruction
+	m_Workers.clear();
+}
+
+void WorkerPool::Resize(uint32_t workerCount)
+{
+	workerCount = std::max(1u, workerCount);
+
+	ReapRetiredWorkers();
+
+	{
+		std::scoped_lock lock(m_Mutex);
+
+		const uint32_t liveCount{ m_LiveCount - m_RetireCount };
+		if (workerCount > liveCount)
+		{
+			// workers that were told to retire but haven't yet can just stay
+			uint32_t missingCount{ workerCount - liveCount };
+			const uint32_t keepCount{ std::min(missingCount, m_RetireCount) };
+			m_RetireCount -= keepCount;
+			missingCount -= keepCount;
+
+			for (uint32_t i = 0; i < missingCount; i++)
+			{
+				StartWorker();
+			}
+		}
+		else
+		{
+			m_RetireCount += liveCount - workerCount;
+		}
+
+		m_TargetSize.store(workerCount, std::memory_order_relaxed);
+	}
+
+	m_TaskCV.notify_all();
+}
+
+void WorkerPool::Push(std::function<void()>&& task)
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_Tasks.emplace_back(m_Metrics.Track(std::move(task)));
+	}
+
+	m_TaskCV.notify_one();
+}
+
+void WorkerPool::StartWorker()
+{
+	m_LiveCount++;
+
+	Worker* worker{ m_Workers.emplace_back(std::make_unique<Worker>()).get() };
+	worker->thread = std::jthread([this, worker]()
+		{
+			RunWorker();
+			worker->finished.store(true, std::memory_order_release);
+		});
+}
+
+void WorkerPool::RunWorker()
+{
+	while (true)
+	{
+		std::function<void()> task{};
+		{
+			std::unique_lock lock(m_Mutex);
+			m_TaskCV.wait(lock, [this]() { return m_Stopping || m_RetireCount > 0 || !m_Tasks.empty(); });
+
+			// retiring comes before the queue, whatever is queued goes to the workers that stay
+			if (m_RetireCount > 0 && !m_Stopping)
+			{
+				m_RetireCount--;
+				m_LiveCount--;
+				return;
+			}
+
+			if (m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void WorkerPool::ReapRetiredWorkers()
+{
+	std::list<std::unique_ptr<Worker>> retiredWorkers{};
+	{
+		std::scoped_lock lock(m_Mutex);
+		for (auto it = m_Workers.begin(); it != m_Workers.end();)
+		{
+			if ((*it)->finished.load(std::memory_order_acquire))
+			{
+				retiredWorkers.splice(retiredWorkers.end(), m_Workers, it++);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	// joined outside the lock, they're done anyway
+	retiredWorkers.clear();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ThreadPoolMetrics.h"
+
+/// <summary>
+/// Thread pool that can grow and shrink while it's being used.
+/// Growing starts new workers right away. Shrinking asks workers to retire,
+/// a retiring worker finishes the task it's running and leaves the queue to the ones that stay,
+/// so nothing queued is lost and nothing that's running gets cut off
+/// </summary>
+class WorkerPool
+{
+public:
+
+	explicit WorkerPool(uint32_t workerCount);
+
+	// Runs whatever is still queued, then joins every worker
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Never goes below one worker
+	void Resize(uint32_t workerCount);
+
+	// The count it's been resized to, workers that are still retiring aren't counted
+	uint32_t Size() const { return m_TargetSize.load(std::memory_order_relaxed); }
+
+	ThreadPoolMetrics::Snapshot GetMetrics() const { return m_Metrics.GetSnapshot(Size()); }
+	void ResetLatencies() { m_Metrics.ResetLatencies(); }
+
+	template<typename Func, typename... Args>
+	std::future<std::invoke_result_t<Func, Args...>> Enqueue(Func&& func, Args&&... args);
+
+	template<typename Func, typename... Args>
+	void EnqueueDetach(Func&& func, Args&&... args);
+
+private:
+
+	struct Worker
+	{
+		std::jthread thread;
+		std::atomic_bool finished{};
+	};
+
+	void Push(std::function<void()>&& task);
+	void StartWorker();
+	void RunWorker();
+
+	// Joins the workers that already retired
+	void ReapRetiredWorkers();
+
+	// declared first so it outlives the workers that still report to it
+	ThreadPoolMetrics m_Metrics;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_TaskCV;
+	std::deque<std::function<void()>> m_Tasks;
+	std::list<std::unique_ptr<Worker>> m_Workers;
+	uint32_t m_LiveCount{}; // workers that haven't retired, the ones asked to retire included
+	uint32_t m_RetireCount{}; // workers asked to retire that haven't picked it up yet
+	bool m_Stopping{};
+
+	std::atomic<uint32_t> m_TargetSize{};
+};
+
+template<typename Func, typename... Args>
+std::future<std::invoke_result_t<Func, Args...>> WorkerPool::Enqueue(Func&& func, Args&&... args)
+{
+	using ReturnType = std::invoke_result_t<Func, Args...>;
+
+	// std::function has to be copyable, the packaged_task isn't
+	auto task{ std::make_shared<std::packaged_task<ReturnType()>>(
+		[lfunc = std::forward<Func>(func), ...largs = std::forward<Args>(args)]() mutable -> ReturnType
+		{
+			return std::invoke(lfunc, largs...);
+		}) };
+
+	std::future<ReturnType> future{ task->get_future() };
+	Push([task]() { (*task)(); });
+
+	return future;
+}
+
+template<typename Func, typename... Args>
+void WorkerPool::EnqueueDetach(Func&& func, Args&&... args)
+{
+	Push([lfunc = std::forward<Func>(func), ...largs = std::forward<Args>(args)]() mutable
+		{
+			std::invoke(lfunc, largs...);
+		});
+}
@@ -2,11 +2,37 @@
 
 #include <future>
 #include <execution>
+#include <fstream>
+#include <array>
+
+#include "openssl/evp.h"
 
 #include "LFQueue.h"
 #include "Types.h"
 #include "ThreadPool.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#ifdef max
+#undef max
+#endif
+
+#ifdef min
+#undef min
+#endif
+
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#endif
+
 namespace fs = std::filesystem;
 
 struct FileSearchArgs
@@ -83,6 +109,7 @@ powe::details::DirectoryTree RecursiveFileSearch(std::string_view searchFolderPa
 	//	fileSearchArgs);
 
 	// Wait for all of threads finish works
+	const ThreadPoolMetrics::BlockScope blockScope{};
 	std::unique_lock lock(activeTaskMutex);
 	waitCV.wait(lock, [&activeTasks = std::as_const(activeTasks)]
 		{
@@ -116,3 +143,154 @@ std::string GetModName(std::string_view modsFodlerPath, std::string_view modPath
 	modsName = modsName.substr(0, modsName.find_first_of("/\\"));
 	return modsName;
 }
+
+#ifdef __linux__
+// Reflink when the filesystem supports it (btrfs, xfs), otherwise let the kernel
+// copy the extents with copy_file_range so the data never goes through user space
+bool CopyFileKernel(const fs::path& sourcePath, const fs::path& targetPath, bool reflinkOnly = false)
+{
+	const int sourceFd{ ::open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC) };
+	if (sourceFd < 0)
+		return false;
+
+	struct stat sourceStat {};
+	if (::fstat(sourceFd, &sourceStat) != 0)
+	{
+		::close(sourceFd);
+		return false;
+	}
+
+	const int targetFd{ ::open(targetPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sourceStat.st_mode & 0777) };
+	if (targetFd < 0)
+	{
+		::close(sourceFd);
+		return false;
+	}
+
+	bool copyResult{ ::ioctl(targetFd, FICLONE, sourceFd) == 0 };
+
+	if (!copyResult && !reflinkOnly)
+	{
+		off_t remaining{ sourceStat.st_size };
+		while (remaining > 0)
+		{
+			const ssize_t written{ ::copy_file_range(sourceFd, nullptr, targetFd, nullptr, size_t(remaining), 0) };
+			if (written <= 0)
+				break;
+
+			remaining -= written;
+		}
+
+		copyResult = remaining == 0;
+	}
+
+	::close(targetFd);
+	::close(sourceFd);
+
+	if (!copyResult && reflinkOnly)
+	{
+		std::error_code errorCode{};
+		fs::remove(targetPath, errorCode);
+	}
+
+	return copyResult;
+}
+#endif
+
+bool CopyFileFast(const fs::path& sourcePath, const fs::path& targetPath)
+{
+#ifdef __linux__
+	if (CopyFileKernel(sourcePath, targetPath))
+		return true;
+#endif
+
+	// On Windows copy_file goes through CopyFile2 which already does an unbuffered kernel copy
+	return fs::copy_file(sourcePath, targetPath, fs::copy_options::overwrite_existing);
+}
+
+bool LinkOrCopyFile(const fs::path& sourcePath, const fs::path& targetPath)
+{
+	std::error_code errorCode{};
+	fs::remove(targetPath, errorCode);
+
+#ifdef __linux__
+	if (CopyFileKernel(sourcePath, targetPath, true))
+		return true;
+#endif
+
+	// Hard link only works on the same volume, we're fine with the error
+	fs::create_hard_link(sourcePath, targetPath, errorCode);
+	if (!errorCode)
+		return true;
+
+	return CopyFileFast(sourcePath, targetPath);
+}
+
+bool MoveFileAcrossVolumes(const fs::path& sourcePath, const fs::path& targetPath)
+{
+	std::error_code errorCode{};
+	fs::rename(sourcePath, targetPath, errorCode);
+	if (!errorCode)
+		return true;
+
+	fs::remove(targetPath, errorCode);
+	if (!CopyFileFast(sourcePath, targetPath))
+		return false;
+
+	fs::remove(sourcePath, errorCode);
+	return true;
+}
+
+uint64_t GetPhysicalMemoryBytes()
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX memoryStatus{ sizeof(memoryStatus) };
+	if (GlobalMemoryStatusEx(&memoryStatus))
+		return memoryStatus.ullTotalPhys;
+#elif defined(__linux__)
+	const long pageCount{ sysconf(_SC_PHYS_PAGES) };
+	const long pageSize{ sysconf(_SC_PAGE_SIZE) };
+	if (pageCount > 0 && pageSize > 0)
+		return uint64_t(pageCount) * uint64_t(pageSize);
+#endif
+
+	return 0;
+}
+
+int64_t GetLastWriteTimeCount(const fs::path& filePath)
+{
+	return int64_t(fs::last_write_time(filePath).time_since_epoch().count());
+}
+
+std::string CalculateFileSHA256(const fs::path& filePath)
+{
+	std::ifstream fileStream(filePath, std::ios::binary);
+	if (!fileStream.is_open())
+		return {};
+
+	std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context{ EVP_MD_CTX_new(), &EVP_MD_CTX_free };
+	if (!context || !EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr))
+		return {};
+
+	// Archives can be a few GBs so never read the whole file at once
+	std::vector<char> buffer(1 << 20);
+	while (fileStream.read(buffer.data(), std::streamsize(buffer.size())) || fileStream.gcount() > 0)
+	{
+		EVP_DigestUpdate(context.get(), buffer.data(), size_t(fileStream.gcount()));
+	}
+
+	std::array<unsigned char, EVP_MAX_MD_SIZE> hash{};
+	unsigned int hashLength{};
+	EVP_DigestFinal_ex(context.get(), hash.data(), &hashLength);
+
+	constexpr char hexDigits[] = "0123456789abcdef";
+	std::string outHash{};
+	outHash.reserve(hashLength * 2);
+	for (unsigned int i = 0; i < hashLength; i++)
+	{
+		outHash.push_back(hexDigits[hash[i] >> 4]);
+		outHash.push_back(hexDigits[hash[i] & 0xF]);
+	}
+
+	return outHash;
+}
@@ -2,7 +2,7 @@
 
 #include <filesystem>
 #include <string>
-#include <iostream>
+#include "Logger.h"
 #include "Types.h"
 
 powe::details::DirectoryTree RecursiveFileSearch(
@@ -11,6 +11,27 @@ powe::details::DirectoryTree RecursiveFileSearch(
 
 std::string GetModName(std::string_view modsFodlerPath, std::string_view modPath);
 
+// Copy a file using the cheapest mechanism the platform offers.
+// On Linux this tries a FICLONE reflink first and then copy_file_range,
+// both stay inside the kernel. Falls back to std::filesystem::copy_file.
+bool CopyFileFast(const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath);
+
+// Put the source file at targetPath as cheaply as possible: reflink, then hard link, then copy.
+// Only use this when nothing writes to targetPath in place afterwards
+bool LinkOrCopyFile(const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath);
+
+// Rename, or copy and delete when the two paths are on different volumes (tmpfs staging for example)
+bool MoveFileAcrossVolumes(const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath);
+
+// Total physical memory of the machine, 0 if it can't be queried
+uint64_t GetPhysicalMemoryBytes();
+
+// Raw tick count of the last write time, only meant to be compared against itself
+int64_t GetLastWriteTimeCount(const std::filesystem::path& filePath);
+
+// Streaming SHA-256 of a file as a lowercase hex string, empty if the file can't be read
+std::string CalculateFileSHA256(const std::filesystem::path& filePath);
+
 template<typename T, typename U>
 inline std::enable_if_t<std::is_convertible_v<T, std::string_view>&& std::is_convertible_v<U, std::string_view>, bool>
 MakeBackup(T sourcePath, U targetPath)
@@ -19,16 +40,16 @@ MakeBackup(T sourcePath, U targetPath)
 	{
 		const std::filesystem::path pathToBackup = std::filesystem::path(targetPath) / std::filesystem::path(sourcePath).filename();
 		std::filesystem::create_directories(pathToBackup.parent_path()); // Create outputFolder if it doesn't exist
-		bool copyResult{ std::filesystem::copy_file(sourcePath, pathToBackup, std::filesystem::copy_options::overwrite_existing) };
+		bool copyResult{ CopyFileFast(sourcePath, pathToBackup) };
 
 #ifdef _DEBUG
 		if (copyResult)
 		{
-			std::cerr << "Backup of " << targetPath << " is successful\n";
+			Logger::Info("Backup of ", targetPath, " is successful");
 		}
 		else
 		{
-			std::cerr << "Backup of " << targetPath << " is failed\n";
+			Logger::Error("Backup of ", targetPath, " is failed");
 		}
 #endif
 
@@ -36,7 +57,8 @@ MakeBackup(T sourcePath, U targetPath)
 	}
 	catch (const std::filesystem::filesystem_error& e)
 	{
-		std::cerr << "Error: " << e.what() << '\n';
+		Logger::Error(e.what());
 	}
 
+	return false;
 }
\ No newline at end of file
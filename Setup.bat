@@ -17,5 +17,16 @@ echo Extraction completed.
 DEL "%FILENAME%"
 echo ZIP file deleted.
 
+:: zlib sources for the in process entry codec, the project compiles them itself
+SET "ZLIB_URL=https://github.com/madler/zlib/releases/download/v1.3.1/zlib131.zip"
+SET "ZLIB_FILENAME=zlib131.zip"
+
+PowerShell -Command "& {Invoke-WebRequest -Uri '%ZLIB_URL%' -OutFile '%ZLIB_FILENAME%'}"
+PowerShell -Command "& {Expand-Archive -Path '%ZLIB_FILENAME%' -DestinationPath '.' -Force}"
+IF EXIST "zlib" RMDIR /S /Q "zlib"
+REN "zlib-1.3.1" "zlib"
+DEL "%ZLIB_FILENAME%"
+echo zlib extracted.
+
 ENDLOCAL
 pause